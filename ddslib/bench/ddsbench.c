@@ -0,0 +1,763 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dds.h"
+#include "ddsmgr.h"
+#include "epstats.h"
+#include "ringqueue.h"
+
+#define HISTOGRAM_BUCKETS 32
+#define RECV_TIMEOUT_SEC 1
+#define BENCH_TRACE_SPANS (64 * 1024)
+
+struct benchopts {
+    int iterations;
+    int devices;
+    int segments;
+    const char *interfaces;
+    unsigned int latency_us;
+    int payload_size;
+    int producers;
+    int samples;
+    unsigned int queue_depth;
+    const char *capture_path;
+    const char *replay_path;
+    double replay_speed;
+    const char *trace_path;
+};
+
+struct queuebench {
+    struct ringqueue ringqueue;
+    struct epstats epstats;
+    int samples;
+    unsigned long rejected;
+    pthread_mutex_t mutex;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void deadline_after(struct abs_timeout *timo, int seconds)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    timo->seconds = ts.tv_sec + seconds;
+    timo->nseconds = ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x, y;
+
+    x = *(const uint64_t *)a;
+    y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, int count, double pct)
+{
+    int index;
+
+    index = (int)(pct / 100.0 * (count - 1) + 0.5);
+
+    return sorted[index];
+}
+
+/*
+ * The loopback devices answer every MCmd with its own payload.
+ */
+static int echoed(const struct packet_mrsp *mrsp,
+                  const char *payload,
+                  int size)
+{
+    return mrsp->rsp_data != NULL && mrsp->rsp_size == size &&
+           memcmp(mrsp->rsp_data, payload, size) == 0;
+}
+
+static void print_histogram(const uint64_t *samples, int count)
+{
+    unsigned long buckets[HISTOGRAM_BUCKETS];
+    uint64_t us;
+    int i, bucket, last;
+
+    memset(buckets, 0, sizeof(buckets));
+    last = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        us = samples[i] / 1000;
+        bucket = 0;
+        while (us > 1 && bucket < HISTOGRAM_BUCKETS - 1)
+        {
+            us >>= 1;
+            bucket++;
+        }
+        buckets[bucket]++;
+        if (bucket > last)
+        {
+            last = bucket;
+        }
+    }
+
+    printf("  histogram (us):\n");
+    for (i = 0; i <= last; i++)
+    {
+        printf("    < %10lu : %lu\n", 2ul << i, buckets[i]);
+    }
+}
+
+static int bench_init(struct ddsmgr_ctx **ctx,
+                      const struct benchopts *opts)
+{
+    struct ddsmgr_config config;
+    struct abs_timeout timo;
+    uint64_t start, created, ready;
+
+    ddsmgr_config_default(&config);
+    config.interfaces = opts->interfaces;
+    config.capture_path = opts->capture_path;
+
+    start = now_ns();
+    *ctx = ddsmgr_create(&config);
+    if (*ctx == NULL)
+    {
+        return 1;
+    }
+    created = now_ns();
+
+    deadline_after(&timo, RECV_TIMEOUT_SEC);
+    if (ddsmgr_wait_ready(*ctx, DDSMGR_READY_ALL, &timo))
+    {
+        fprintf(stderr, "endpoints did not match\n");
+        return 1;
+    }
+    ready = now_ns();
+
+    printf("init:\n");
+    printf("  create        %10.1f us\n", (created - start) / 1000.0);
+    printf("  ready         %10.1f us\n", (ready - start) / 1000.0);
+
+    return 0;
+}
+
+static int bench_roundtrip(struct ddsmgr_ctx *ctx,
+                           const struct benchopts *opts)
+{
+    struct packet_mrsp mrsp;
+    struct abs_timeout timo;
+    uint64_t *samples;
+    uint64_t start, total;
+    char *payload;
+    char device_name[DDSMGR_DEVICE_NAME_LEN];
+    int i, count, timeouts, mismatched;
+
+    samples = calloc(opts->iterations, sizeof(*samples));
+    payload = malloc(opts->payload_size ? opts->payload_size : 1);
+    if (samples == NULL || payload == NULL)
+    {
+        free(samples);
+        free(payload);
+        return 1;
+    }
+    memset(payload, 0xa5, opts->payload_size);
+
+    count = 0;
+    timeouts = 0;
+    mismatched = 0;
+    total = 0;
+
+    for (i = 0; i < opts->iterations; i++)
+    {
+        snprintf(device_name, sizeof(device_name), "loop%d",
+                 i % opts->devices);
+
+        start = now_ns();
+        if (ddsmgr_mrsp_register(ctx, i))
+        {
+            fprintf(stderr, "ddsmgr_mrsp_register failed\n");
+            break;
+        }
+        ddsmgr_mcmd_publish(ctx, device_name, i, payload, opts->payload_size);
+        deadline_after(&timo, RECV_TIMEOUT_SEC);
+        if (ddsmgr_mrsp_recv(ctx, i, &timo, &mrsp))
+        {
+            timeouts++;
+        }
+        else
+        {
+            samples[count] = now_ns() - start;
+            total += samples[count];
+            count++;
+            mismatched += !echoed(&mrsp, payload, opts->payload_size);
+            ddsmgr_mrsp_release(ctx, &mrsp);
+        }
+        ddsmgr_mrsp_unregister(ctx, i);
+    }
+
+    printf("roundtrip: %d iterations, %d byte payload, %d timeouts, "
+           "%d mismatched\n",
+           opts->iterations, opts->payload_size, timeouts, mismatched);
+    if (count == 0)
+    {
+        free(samples);
+        free(payload);
+        return 1;
+    }
+
+    qsort(samples, count, sizeof(*samples), compare_u64);
+    printf("  mean          %10.1f us\n", (double)total / count / 1000.0);
+    printf("  p50           %10.1f us\n",
+           percentile(samples, count, 50.0) / 1000.0);
+    printf("  p90           %10.1f us\n",
+           percentile(samples, count, 90.0) / 1000.0);
+    printf("  p99           %10.1f us\n",
+           percentile(samples, count, 99.0) / 1000.0);
+    printf("  p99.9         %10.1f us\n",
+           percentile(samples, count, 99.9) / 1000.0);
+    printf("  max           %10.1f us\n", samples[count - 1] / 1000.0);
+    print_histogram(samples, count);
+
+    free(samples);
+    free(payload);
+
+    return timeouts != 0 || mismatched != 0;
+}
+
+/*
+ * Sends the same command to every discovered device, once one device at a
+ * time and once as a single fan-out, and compares the time per round.
+ */
+static int bench_fanout(struct ddsmgr_ctx *ctx,
+                        const struct benchopts *opts)
+{
+    struct ddsmgr_device *devices;
+    struct ddsmgr_fanout_result *results;
+    struct packet_mrsp mrsp;
+    struct abs_timeout timo;
+    const char **names;
+    uint64_t start, sequential, fanout;
+    char payload[16];
+    int count, rounds, incomplete, mismatched, request_id, i, j;
+
+    count = ddsmgr_device_match(ctx, "loop*", NULL, 0);
+    devices = calloc(count ? count : 1, sizeof(*devices));
+    names = calloc(count ? count : 1, sizeof(*names));
+    results = calloc(count ? count : 1, sizeof(*results));
+    if (devices == NULL || names == NULL || results == NULL)
+    {
+        free(devices);
+        free(names);
+        free(results);
+        return 1;
+    }
+    count = ddsmgr_device_match(ctx, "loop*", devices, count);
+    for (i = 0; i < count; i++)
+    {
+        names[i] = devices[i].device_name;
+    }
+    memset(payload, 0x5a, sizeof(payload));
+
+    rounds = opts->iterations / (count ? count : 1);
+    if (rounds < 1)
+    {
+        rounds = 1;
+    }
+    incomplete = 0;
+    mismatched = 0;
+    sequential = 0;
+    fanout = 0;
+    request_id = 0;
+
+    for (i = 0; i < rounds; i++)
+    {
+        start = now_ns();
+        deadline_after(&timo, RECV_TIMEOUT_SEC);
+        for (j = 0; j < count; j++, request_id++)
+        {
+            ddsmgr_mrsp_register(ctx, request_id);
+            ddsmgr_mcmd_publish(ctx, names[j], request_id,
+                                payload, sizeof(payload));
+            if (ddsmgr_mrsp_recv(ctx, request_id, &timo, &mrsp) == 0)
+            {
+                mismatched += !echoed(&mrsp, payload, sizeof(payload));
+                ddsmgr_mrsp_release(ctx, &mrsp);
+            }
+            else
+            {
+                incomplete++;
+            }
+            ddsmgr_mrsp_unregister(ctx, request_id);
+        }
+        sequential += now_ns() - start;
+
+        start = now_ns();
+        deadline_after(&timo, RECV_TIMEOUT_SEC);
+        if (ddsmgr_mcmd_fanout(ctx, names, count, request_id,
+                               payload, sizeof(payload),
+                               &timo, results) != count)
+        {
+            incomplete++;
+        }
+        for (j = 0; j < count; j++)
+        {
+            mismatched += results[j].status == 0 &&
+                          !echoed(&results[j].mrsp, payload,
+                                  sizeof(payload));
+        }
+        ddsmgr_mcmd_fanout_release(ctx, results, count);
+        fanout += now_ns() - start;
+        request_id += count;
+    }
+
+    printf("fanout: %d rounds across %d devices, %d incomplete, "
+           "%d mismatched\n", rounds, count, incomplete, mismatched);
+    printf("  sequential    %10.1f us\n", sequential / 1000.0 / rounds);
+    printf("  fanout        %10.1f us\n", fanout / 1000.0 / rounds);
+
+    free(devices);
+    free(names);
+    free(results);
+
+    return count != opts->devices || incomplete != 0 || mismatched != 0;
+}
+
+/*
+ * Sends the same number of MCmds once synchronously and once through the
+ * publish queue.  For the posted run, "call" is the time the caller spent
+ * in ddsmgr and "total" includes waiting for the writer to catch up.
+ *
+ * Only the cost of publishing is timed, so nobody registers the request
+ * ids and every response is dropped as unknown.  Those drops are counted
+ * to check that each command was published and answered.
+ */
+static int bench_publish(struct ddsmgr_ctx *ctx,
+                         const struct benchopts *opts)
+{
+    struct ddsmgr_stats before, after;
+    struct abs_timeout timo;
+    unsigned long long token;
+    unsigned long rejected;
+    uint64_t start, sync, call, total, deadline;
+    long long unanswered;
+    char payload[64];
+    int i;
+
+    memset(payload, 0x3c, sizeof(payload));
+    ddsmgr_stats(ctx, &before);
+
+    start = now_ns();
+    for (i = 0; i < opts->iterations; i++)
+    {
+        ddsmgr_mcmd_publish(ctx, "loop0", i, payload, sizeof(payload));
+    }
+    sync = now_ns() - start;
+
+    rejected = 0;
+    token = 0;
+    call = 0;
+    start = now_ns();
+    for (i = 0; i < opts->iterations; i++)
+    {
+        uint64_t posted = now_ns();
+
+        while (ddsmgr_mcmd_post(ctx, "loop0", i, payload, sizeof(payload),
+                                NULL, NULL, &token))
+        {
+            rejected++;
+            sched_yield();
+        }
+        call += now_ns() - posted;
+    }
+    deadline_after(&timo, RECV_TIMEOUT_SEC);
+    if (ddsmgr_post_wait(ctx, token, &timo))
+    {
+        fprintf(stderr, "posted commands were not published\n");
+        return 1;
+    }
+    total = now_ns() - start;
+
+    deadline = now_ns() + RECV_TIMEOUT_SEC * 1000000000ull;
+    for (;;)
+    {
+        ddsmgr_stats(ctx, &after);
+        unanswered = 2ll * opts->iterations -
+                     (long long)(after.mrsp.dropped_unknown -
+                                 before.mrsp.dropped_unknown);
+        if (unanswered <= 0 || now_ns() >= deadline)
+        {
+            break;
+        }
+        usleep(1000);
+    }
+
+    printf("publish: %d commands, %lu posts refused, %lld unanswered\n",
+           opts->iterations, rejected, unanswered);
+    printf("  sync          %10.2f us/cmd\n",
+           sync / 1000.0 / opts->iterations);
+    printf("  post call     %10.2f us/cmd\n",
+           call / 1000.0 / opts->iterations);
+    printf("  post total    %10.2f us/cmd\n",
+           total / 1000.0 / opts->iterations);
+
+    return unanswered != 0;
+}
+
+static void convert_pong(void *dst, void *src)
+{
+    memcpy(dst, src, sizeof(struct packet_pong));
+}
+
+/*
+ * Producers retry rejected samples so that every sample reaches the
+ * consumer; the rejection count shows how often the queue was full.
+ */
+static void *queue_producer(void *arg)
+{
+    struct queuebench *qb;
+    struct packet_pong pong;
+    unsigned long rejected;
+    int i;
+
+    qb = arg;
+    rejected = 0;
+    memset(&pong, 0, sizeof(pong));
+
+    for (i = 0; i < qb->samples; i++)
+    {
+        pong.request_id = i;
+        while (ringqueue_produce(&qb->ringqueue, &pong))
+        {
+            rejected++;
+            sched_yield();
+        }
+    }
+
+    pthread_mutex_lock(&qb->mutex);
+    qb->rejected += rejected;
+    pthread_mutex_unlock(&qb->mutex);
+
+    return NULL;
+}
+
+static int bench_queue(const struct benchopts *opts)
+{
+    struct queuebench qb;
+    struct packet_pong pong;
+    struct abs_timeout timo;
+    pthread_t *threads;
+    uint64_t start, elapsed;
+    unsigned long total, consumed;
+    int i;
+
+    memset(&qb, 0, sizeof(qb));
+    qb.samples = opts->samples;
+    pthread_mutex_init(&qb.mutex, NULL);
+
+    epstats_initialize(&qb.epstats);
+    if (ringqueue_initialize(&qb.ringqueue, opts->queue_depth,
+                             sizeof(struct packet_pong), convert_pong,
+                             &qb.epstats))
+    {
+        return 1;
+    }
+    ringqueue_listen(&qb.ringqueue);
+
+    threads = calloc(opts->producers, sizeof(*threads));
+    if (threads == NULL)
+    {
+        ringqueue_destroy(&qb.ringqueue);
+        return 1;
+    }
+
+    total = (unsigned long)opts->producers * opts->samples;
+    consumed = 0;
+
+    start = now_ns();
+    for (i = 0; i < opts->producers; i++)
+    {
+        pthread_create(&threads[i], NULL, queue_producer, &qb);
+    }
+
+    while (consumed < total)
+    {
+        deadline_after(&timo, RECV_TIMEOUT_SEC);
+        if (ringqueue_consume(&qb.ringqueue, &pong, &timo))
+        {
+            break;
+        }
+        consumed++;
+    }
+    elapsed = now_ns() - start;
+
+    for (i = 0; i < opts->producers; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("ringqueue: %d producers x %d samples, depth %u\n",
+           opts->producers, opts->samples, opts->queue_depth);
+    printf("  consumed      %10lu (%.0f samples/s)\n", consumed,
+           consumed / (elapsed / 1e9));
+    printf("  full          %10lu rejections\n", qb.rejected);
+    printf("  peak wait     %10.1f us\n",
+           atomic_load(&qb.epstats.peak_wait_ns) / 1000.0);
+
+    free(threads);
+    ringqueue_destroy(&qb.ringqueue);
+    pthread_mutex_destroy(&qb.mutex);
+
+    return consumed != total;
+}
+
+static int bench_discover(struct ddsmgr_ctx *ctx,
+                          const struct benchopts *opts)
+{
+    struct packet_ping ping;
+    struct abs_timeout timo;
+    struct timespec ts;
+    uint64_t start, elapsed;
+    int found;
+
+    ping.request_id = 0x7fff;
+
+    /* Leave the pongs ten latencies (at least 10 ms) to come back. */
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 10000000l + 10000l * opts->latency_us;
+    ts.tv_sec += ts.tv_nsec / 1000000000l;
+    ts.tv_nsec %= 1000000000l;
+    timo.seconds = ts.tv_sec;
+    timo.nseconds = ts.tv_nsec;
+
+    start = now_ns();
+    found = ddsmgr_discover(ctx, &ping, &timo);
+    elapsed = now_ns() - start;
+
+    printf("discover: %d of %d devices in %.1f ms\n",
+           found, opts->devices, elapsed / 1e6);
+
+    return found != opts->devices;
+}
+
+static int bench_replay(struct ddsmgr_ctx *ctx,
+                        const struct benchopts *opts)
+{
+    uint64_t start, elapsed;
+    int replayed;
+
+    start = now_ns();
+    replayed = ddsmgr_replay(ctx, opts->replay_path, opts->replay_speed);
+    elapsed = now_ns() - start;
+    if (replayed < 0)
+    {
+        return 1;
+    }
+
+    printf("replay: %d samples at %gx in %.1f ms (%.0f samples/s)\n",
+           replayed, opts->replay_speed, elapsed / 1e6,
+           elapsed ? replayed * 1e9 / elapsed : 0.0);
+
+    return 0;
+}
+
+/*
+ * Drops are broken down by reason on a second line when there are any.
+ * The bench causes some on purpose: pongs arrive while discovery is not
+ * listening for them, refused posts are retried, and the responses to the
+ * publish run are not collected.
+ */
+static void print_endpoint_stats(const char *name,
+                                 const struct ddsmgr_endpoint_stats *eps)
+{
+    unsigned long long dropped;
+
+    dropped = eps->dropped_disabled + eps->dropped_full +
+              eps->dropped_unknown + eps->dropped_nobuf +
+              eps->dropped_duplicate;
+
+    printf("  %-5s %8llu samples %8llu converted %10llu bytes "
+           "%6llu dropped %4llu errors %4llu timeouts %8.1f us peak\n",
+           name, eps->samples, eps->converted, eps->bytes, dropped,
+           eps->errors, eps->timeouts, eps->peak_wait_ns / 1000.0);
+    if (dropped)
+    {
+        printf("        dropped: %llu disabled, %llu full, %llu unknown, "
+               "%llu nobuf, %llu duplicate\n",
+               eps->dropped_disabled, eps->dropped_full,
+               eps->dropped_unknown, eps->dropped_nobuf,
+               eps->dropped_duplicate);
+    }
+}
+
+static void print_stats(struct ddsmgr_ctx *ctx)
+{
+    struct ddsmgr_stats stats;
+
+    ddsmgr_stats(ctx, &stats);
+
+    printf("stats:\n");
+    print_endpoint_stats("mcmd", &stats.mcmd);
+    print_endpoint_stats("mrsp", &stats.mrsp);
+    print_endpoint_stats("ping", &stats.ping);
+    print_endpoint_stats("pong", &stats.pong);
+}
+
+static int bench_trace(const struct benchopts *opts)
+{
+    int spans;
+
+    if (opts->trace_path == NULL)
+    {
+        return 0;
+    }
+
+    ddsmgr_trace_stop();
+    spans = ddsmgr_trace_write(opts->trace_path);
+    if (spans < 0)
+    {
+        fprintf(stderr, "failed to write trace to %s\n", opts->trace_path);
+        return 1;
+    }
+    printf("trace: %d spans written to %s\n", spans, opts->trace_path);
+
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n iterations] [-d devices] [-S segments]\n"
+            "       [-I interfaces] [-l latency_us]\n"
+            "       [-s payload_size] [-p producers] [-q samples]\n"
+            "       [-Q queue_depth] [-w capture_file]\n"
+            "       [-r capture_file [-R speed]] [-t trace_file]\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct benchopts opts;
+    struct ddsmgr_ctx *ctx;
+    int opt, result;
+
+    opts.iterations = 10000;
+    opts.devices = 4;
+    opts.segments = 1;
+    opts.interfaces = NULL;
+    opts.latency_us = 0;
+    opts.payload_size = 64;
+    opts.producers = 4;
+    opts.samples = 1000000;
+    opts.queue_depth = DDSMGR_DEFAULT_QUEUE_DEPTH;
+    opts.capture_path = NULL;
+    opts.replay_path = NULL;
+    opts.replay_speed = 0;
+    opts.trace_path = NULL;
+
+    while ((opt = getopt(argc, argv, "n:d:S:I:l:s:p:q:Q:w:r:R:t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            opts.iterations = atoi(optarg);
+            break;
+        case 'd':
+            opts.devices = atoi(optarg);
+            break;
+        case 'S':
+            opts.segments = atoi(optarg);
+            break;
+        case 'I':
+            opts.interfaces = optarg;
+            break;
+        case 'l':
+            opts.latency_us = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            opts.payload_size = atoi(optarg);
+            break;
+        case 'p':
+            opts.producers = atoi(optarg);
+            break;
+        case 'q':
+            opts.samples = atoi(optarg);
+            break;
+        case 'Q':
+            opts.queue_depth = strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            opts.capture_path = optarg;
+            break;
+        case 'r':
+            opts.replay_path = optarg;
+            break;
+        case 'R':
+            opts.replay_speed = strtod(optarg, NULL);
+            break;
+        case 't':
+            opts.trace_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (opts.iterations <= 0 || opts.devices <= 0 || opts.segments <= 0 ||
+        opts.producers <= 0 || opts.samples <= 0 || opts.payload_size < 0 ||
+        opts.queue_depth == 0 || opts.replay_speed < 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    dds_loopback_configure(opts.devices, opts.segments, opts.latency_us);
+
+    if (bench_init(&ctx, &opts))
+    {
+        return 1;
+    }
+
+    if (opts.trace_path != NULL && ddsmgr_trace_start(BENCH_TRACE_SPANS))
+    {
+        fprintf(stderr, "failed to start trace\n");
+        ddsmgr_destroy(ctx);
+        return 1;
+    }
+
+    /* A replay needs no devices; it feeds the receive path directly. */
+    if (opts.replay_path != NULL)
+    {
+        result = bench_replay(ctx, &opts);
+        result |= bench_trace(&opts);
+        print_stats(ctx);
+        ddsmgr_destroy(ctx);
+        return result;
+    }
+
+    result = 0;
+    result |= bench_discover(ctx, &opts);
+    result |= bench_roundtrip(ctx, &opts);
+    result |= bench_fanout(ctx, &opts);
+    result |= bench_publish(ctx, &opts);
+    result |= bench_trace(&opts);
+    print_stats(ctx);
+    result |= bench_queue(&opts);
+
+    ddsmgr_destroy(ctx);
+
+    return result;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "check.h"
+
+struct checksuite {
+    const char *name;
+    void (*run)(void);
+};
+
+static const struct checksuite suites[] = {
+    { "ringqueue", check_ringqueue },
+    { "pendtable", check_pendtable },
+    { "devregistry", check_devregistry },
+    { "futexwait", check_futexwait },
+    { "capture", check_capture },
+    { "pubqueue", check_pubqueue },
+    { "ddsmgr", check_ddsmgr },
+};
+
+static int failures;
+
+void check_result(int passed,
+                  const char *expr,
+                  const char *file,
+                  int line)
+{
+    if (!passed)
+    {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+        failures++;
+    }
+}
+
+/*
+ * Sets timo to ms milliseconds from now on the realtime clock, as every
+ * ddslib deadline is.
+ */
+void check_deadline(struct abs_timeout *timo,
+                    unsigned int ms)
+{
+    struct timespec ts;
+    long nseconds;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    nseconds = ts.tv_nsec + (long)(ms % 1000) * 1000000;
+    timo->seconds = ts.tv_sec + ms / 1000 + nseconds / 1000000000;
+    timo->nseconds = nseconds % 1000000000;
+}
+
+/*
+ * Runs every suite, or only those named on the command line.
+ */
+int main(int argc, char **argv)
+{
+    unsigned int i;
+    int before, selected, j;
+
+    for (i = 0; i < sizeof(suites) / sizeof(suites[0]); i++)
+    {
+        selected = argc < 2;
+        for (j = 1; j < argc; j++)
+        {
+            selected |= strcmp(argv[j], suites[i].name) == 0;
+        }
+        if (!selected)
+        {
+            continue;
+        }
+
+        before = failures;
+        suites[i].run();
+        printf("%-12s %s\n", suites[i].name,
+               failures == before ? "ok" : "FAILED");
+    }
+
+    return failures != 0;
+}
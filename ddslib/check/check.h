@@ -0,0 +1,29 @@
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include "ddsmgr.h"
+
+/*
+ * Behaviour checks for the ddslib units, run against the loopback DDS
+ * stand-in.  CHECK() records a failed expectation with its location and
+ * carries on, so one run reports everything a change broke.  Each unit
+ * has one suite, listed in check.c.
+ */
+#define CHECK(cond) check_result((cond) != 0, #cond, __FILE__, __LINE__)
+
+void check_result(int passed,
+                  const char *expr,
+                  const char *file,
+                  int line);
+void check_deadline(struct abs_timeout *timo,
+                    unsigned int ms);
+
+void check_ringqueue(void);
+void check_pendtable(void);
+void check_devregistry(void);
+void check_futexwait(void);
+void check_capture(void);
+void check_pubqueue(void);
+void check_ddsmgr(void);
+
+#endif
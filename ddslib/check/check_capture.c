@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "capture.h"
+#include "check.h"
+#include "epstats.h"
+
+#define CAP_TEMPLATE "/tmp/ddscheck-capture-XXXXXX"
+
+static int make_path(char *path)
+{
+    int fd;
+
+    strcpy(path, CAP_TEMPLATE);
+    fd = mkstemp(path);
+    if (fd < 0)
+    {
+        return 1;
+    }
+    close(fd);
+
+    return 0;
+}
+
+/*
+ * Writes a record with a chosen stamp, which capture_record() cannot.
+ */
+static void write_record(FILE *file,
+                         enum capturetype type,
+                         int request_id,
+                         uint64_t stamp_ns,
+                         const char *name,
+                         const char *data)
+{
+    struct capture_record record;
+
+    memset(&record, 0, sizeof(record));
+    record.stamp_ns = stamp_ns;
+    record.request_id = request_id;
+    record.data_len = strlen(data);
+    record.type = type;
+    record.name_len = strlen(name);
+
+    fwrite(&record, sizeof(record), 1, file);
+    fwrite(name, 1, record.name_len, file);
+    fwrite(data, 1, record.data_len, file);
+}
+
+static void check_roundtrip(const char *path)
+{
+    struct capture capture;
+    struct capture_reader reader;
+    struct capture_record record;
+    char name[CAPTURE_NAME_MAX + 1];
+    char payload[300];
+    const char *data;
+    char *big;
+    uint64_t before;
+
+    memset(payload, 0x5a, sizeof(payload));
+    before = epstats_now();
+
+    CHECK(capture_open(&capture, path) == 0);
+    capture_record(&capture, CAPTURETYPE_MCMD, 7, 0, "dev0", "abc", 3);
+    capture_record(&capture, CAPTURETYPE_MRSP, 7, 0, NULL, payload,
+                   sizeof(payload));
+    capture_record(&capture, CAPTURETYPE_PONG, 9, 2,
+                   "a-device-name-longer-than-sixteen", NULL, 0);
+    capture_close(&capture);
+
+    CHECK(capture_reader_open(&reader, path) == 0);
+
+    CHECK(capture_read(&reader, &record, name, &data) == 0);
+    CHECK(record.type == CAPTURETYPE_MCMD && record.request_id == 7);
+    CHECK(record.stamp_ns >= before);
+    CHECK(strcmp(name, "dev0") == 0);
+    CHECK(record.data_len == 3 && memcmp(data, "abc", 3) == 0);
+    before = record.stamp_ns;
+
+    /* The reader grows its buffer for a larger payload. */
+    CHECK(capture_read(&reader, &record, name, &data) == 0);
+    CHECK(record.type == CAPTURETYPE_MRSP && record.request_id == 7);
+    CHECK(record.stamp_ns >= before);
+    CHECK(name[0] == '\0');
+    CHECK(record.data_len == sizeof(payload) &&
+          memcmp(data, payload, sizeof(payload)) == 0);
+
+    /* Names are cut to CAPTURE_NAME_MAX, and the interface is kept. */
+    CHECK(capture_read(&reader, &record, name, &data) == 0);
+    CHECK(record.type == CAPTURETYPE_PONG && record.interface == 2);
+    CHECK(strcmp(name, "a-device-name-lo") == 0);
+    CHECK(record.data_len == 0);
+
+    CHECK(capture_read(&reader, &record, name, &data) == 1);
+    capture_reader_close(&reader);
+
+    /* Opening the capture again starts it afresh. */
+    CHECK(capture_open(&capture, path) == 0);
+    capture_record(&capture, CAPTURETYPE_PING, 1, 0, NULL, NULL, 0);
+    capture_close(&capture);
+
+    CHECK(capture_reader_open(&reader, path) == 0);
+    CHECK(capture_read(&reader, &record, name, &data) == 0);
+    CHECK(record.type == CAPTURETYPE_PING && record.request_id == 1);
+    CHECK(capture_read(&reader, &record, name, &data) == 1);
+    capture_reader_close(&reader);
+
+    /* Payloads are cut to CAPTURE_DATA_MAX, so the reader accepts them. */
+    big = calloc(1, CAPTURE_DATA_MAX + 100);
+    CHECK(capture_open(&capture, path) == 0);
+    capture_record(&capture, CAPTURETYPE_MRSP, 2, 0, NULL, big,
+                   CAPTURE_DATA_MAX + 100);
+    capture_close(&capture);
+    free(big);
+
+    CHECK(capture_reader_open(&reader, path) == 0);
+    CHECK(capture_read(&reader, &record, name, &data) == 0);
+    CHECK(record.data_len == CAPTURE_DATA_MAX);
+    CHECK(capture_read(&reader, &record, name, &data) == 1);
+    capture_reader_close(&reader);
+}
+
+static void check_malformed(const char *path)
+{
+    struct capture_reader reader;
+    struct capture_record record;
+    char name[CAPTURE_NAME_MAX + 1];
+    const char *data;
+    static const uint32_t oversized[] = { CAPTURE_DATA_MAX + 1, UINT32_MAX };
+    FILE *file;
+    unsigned int i;
+
+    /* A file without the magic is not a capture. */
+    file = fopen(path, "wb");
+    fputs("not a capture", file);
+    fclose(file);
+    CHECK(capture_reader_open(&reader, path) == 1);
+
+    /* A name longer than any capture writes ends the file. */
+    file = fopen(path, "wb");
+    fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1, 1, file);
+    write_record(file, CAPTURETYPE_PONG, 1, 0,
+                 "a-device-name-longer-than-sixteen", "");
+    fclose(file);
+    CHECK(capture_reader_open(&reader, path) == 0);
+    CHECK(capture_read(&reader, &record, name, &data) == 1);
+    capture_reader_close(&reader);
+
+    /* So does a payload longer than any MCmd or MRsp, before the reader
+     * allocates room for it. */
+    for (i = 0; i < sizeof(oversized) / sizeof(*oversized); i++)
+    {
+        memset(&record, 0, sizeof(record));
+        record.type = CAPTURETYPE_MRSP;
+        record.data_len = oversized[i];
+        file = fopen(path, "wb");
+        fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1, 1, file);
+        fwrite(&record, sizeof(record), 1, file);
+        fclose(file);
+        CHECK(capture_reader_open(&reader, path) == 0);
+        CHECK(capture_read(&reader, &record, name, &data) == 1);
+        CHECK(reader.data_size == 0);
+        capture_reader_close(&reader);
+    }
+
+    /* So does a record cut short. */
+    file = fopen(path, "wb");
+    fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1, 1, file);
+    write_record(file, CAPTURETYPE_MRSP, 1, 0, "", "payload");
+    fclose(file);
+    CHECK(truncate(path, sizeof(CAPTURE_MAGIC) - 1 +
+                         sizeof(struct capture_record) + 3) == 0);
+    CHECK(capture_reader_open(&reader, path) == 0);
+    CHECK(capture_read(&reader, &record, name, &data) == 1);
+    capture_reader_close(&reader);
+}
+
+/*
+ * Replays at the recorded rate a capture whose stamps jump back by
+ * seconds; the jump must cost nothing rather than a wrapped-around wait.
+ */
+static void check_replay(const char *path)
+{
+    struct ddsmgr_config config;
+    struct ddsmgr_ctx *ctx;
+    struct ddsmgr_stats before, after;
+    uint64_t start;
+    FILE *file;
+
+    file = fopen(path, "wb");
+    fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1, 1, file);
+    write_record(file, CAPTURETYPE_MCMD, 7, 5000000000ull, "loop0", "cmd");
+    write_record(file, CAPTURETYPE_MRSP, 7, 5001000000ull, "", "rsp");
+    write_record(file, CAPTURETYPE_PONG, 8, 1000000ull, "loop0", "");
+    write_record(file, CAPTURETYPE_MRSP, 9, 2000000ull, "", "stray");
+    fclose(file);
+
+    ddsmgr_config_default(&config);
+    ctx = ddsmgr_create(&config);
+    CHECK(ctx != NULL);
+    if (ctx == NULL)
+    {
+        return;
+    }
+
+    ddsmgr_stats(ctx, &before);
+    start = epstats_now();
+    CHECK(ddsmgr_replay(ctx, path, 1.0) == 3);
+    CHECK(epstats_now() - start < 1000000000ull);
+    ddsmgr_stats(ctx, &after);
+
+    /* The recorded request gets its response; the stray one is dropped. */
+    CHECK(after.mrsp.converted - before.mrsp.converted == 1);
+    CHECK(after.mrsp.dropped_unknown - before.mrsp.dropped_unknown == 1);
+    CHECK(after.pong.samples - before.pong.samples == 1);
+
+    ddsmgr_destroy(ctx);
+}
+
+void check_capture(void)
+{
+    char path[sizeof(CAP_TEMPLATE)];
+
+    CHECK(make_path(path) == 0);
+    check_roundtrip(path);
+    check_malformed(path);
+    check_replay(path);
+    unlink(path);
+}
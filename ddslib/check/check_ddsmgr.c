@@ -0,0 +1,72 @@
+#include <stddef.h>
+#include "check.h"
+
+/*
+ * A request whose MCmd could not be published completes at once, without
+ * data, and only its own request does.
+ */
+static void check_unpublished(struct ddsmgr_ctx *ctx)
+{
+    struct packet_mrsp mrsp;
+    struct abs_timeout timo;
+
+    CHECK(ddsmgr_mrsp_register(ctx, 11) == 0);
+    CHECK(ddsmgr_mrsp_register(ctx, 12) == 0);
+
+    ddsmgr_mcmd_posted(ctx, 11, 0);
+    ddsmgr_mcmd_posted(ctx, 12, 1);
+
+    check_deadline(&timo, 10);
+    CHECK(ddsmgr_mrsp_recv(ctx, 11, &timo, &mrsp) == 1);
+
+    check_deadline(&timo, 2000);
+    CHECK(ddsmgr_mrsp_recv(ctx, 12, &timo, &mrsp) == 0);
+    CHECK(mrsp.request_id == 12);
+    CHECK(mrsp.rsp_size == DDSMGR_MRSP_UNPUBLISHED);
+    CHECK(mrsp.rsp_data == NULL);
+    ddsmgr_mrsp_release(ctx, &mrsp);
+
+    ddsmgr_mrsp_unregister(ctx, 11);
+    ddsmgr_mrsp_unregister(ctx, 12);
+}
+
+/*
+ * An id that is already registered is reported as such, apart from other
+ * failures, and a fan-out that runs into one registers nothing.
+ */
+static void check_id_in_use(struct ddsmgr_ctx *ctx)
+{
+    static const char *const names[] = { "loop0", "loop1" };
+    struct ddsmgr_fanout_result results[2];
+    struct abs_timeout timo;
+
+    CHECK(ddsmgr_mrsp_register(ctx, 21) == 0);
+    CHECK(ddsmgr_mrsp_register(ctx, 21) == DDSMGR_ID_IN_USE);
+
+    check_deadline(&timo, 10);
+    CHECK(ddsmgr_mcmd_fanout(ctx, names, 2, 20, "x", 1, &timo,
+                             results) == DDSMGR_FANOUT_ID_IN_USE);
+    CHECK(ddsmgr_mrsp_register(ctx, 20) == 0);
+
+    ddsmgr_mrsp_unregister(ctx, 20);
+    ddsmgr_mrsp_unregister(ctx, 21);
+}
+
+void check_ddsmgr(void)
+{
+    struct ddsmgr_config config;
+    struct ddsmgr_ctx *ctx;
+
+    ddsmgr_config_default(&config);
+    ctx = ddsmgr_create(&config);
+    CHECK(ctx != NULL);
+    if (ctx == NULL)
+    {
+        return;
+    }
+
+    check_unpublished(ctx);
+    check_id_in_use(ctx);
+
+    ddsmgr_destroy(ctx);
+}
@@ -0,0 +1,127 @@
+#include <string.h>
+#include "check.h"
+#include "devregistry.h"
+
+#define DR_BUCKETS 4
+
+static int listed(struct devregistry *dr, const char *pattern)
+{
+    struct ddsmgr_device devices[8];
+
+    return devregistry_list(dr, pattern, devices, 8);
+}
+
+static void check_updates(void)
+{
+    struct devregistry dr;
+    struct ddsmgr_device device, devices[2];
+
+    CHECK(devregistry_initialize(&dr, DR_BUCKETS) == 0);
+
+    CHECK(devregistry_lookup(&dr, "dev0", &device) == 1);
+    CHECK(devregistry_interface(&dr, "dev0") == -1);
+
+    CHECK(devregistry_update(&dr, "dev0", 100, 0, "eth0") == 0);
+    CHECK(devregistry_update(&dr, "dev1", 100, 1, "eth1") == 0);
+    CHECK(devregistry_update(&dr, "other", 101, 0, "eth0") == 0);
+
+    /* A later pong updates the device in place. */
+    CHECK(devregistry_update(&dr, "dev0", 102, 1, "eth1") == 0);
+    CHECK(dr.count == 3);
+    CHECK(devregistry_lookup(&dr, "dev0", &device) == 0);
+    CHECK(strcmp(device.device_name, "dev0") == 0);
+    CHECK(device.request_id == 102);
+    CHECK(strcmp(device.interface_name, "eth1") == 0);
+    CHECK(device.last_seen.seconds != 0);
+    CHECK(devregistry_interface(&dr, "dev0") == 1);
+
+    CHECK(devregistry_count_request(&dr, 100) == 1);
+    CHECK(devregistry_count_request(&dr, 102) == 1);
+    CHECK(devregistry_count_request(&dr, 103) == 0);
+
+    CHECK(listed(&dr, NULL) == 3);
+    CHECK(listed(&dr, "dev*") == 2);
+    CHECK(listed(&dr, "dev[1]") == 1);
+    CHECK(listed(&dr, "none*") == 0);
+
+    /* The count covers every match even when fewer fit. */
+    CHECK(devregistry_list(&dr, NULL, devices, 2) == 3);
+
+    devregistry_destroy(&dr);
+}
+
+/*
+ * Names are compared over DDSMGR_DEVICE_NAME_LEN characters, the most a
+ * pong carries, and are stored terminated.
+ */
+static void check_long_names(void)
+{
+    struct devregistry dr;
+    struct ddsmgr_device device;
+    char name[DDSMGR_DEVICE_NAME_LEN + 1];
+
+    CHECK(devregistry_initialize(&dr, DR_BUCKETS) == 0);
+
+    memset(name, 'n', DDSMGR_DEVICE_NAME_LEN);
+    name[DDSMGR_DEVICE_NAME_LEN] = '\0';
+    CHECK(devregistry_update(&dr, name, 1, 0, "eth0") == 0);
+    CHECK(devregistry_lookup(&dr, name, &device) == 0);
+    CHECK(strlen(device.device_name) == DDSMGR_DEVICE_NAME_LEN);
+    name[DDSMGR_DEVICE_NAME_LEN - 1] = 'm';
+    CHECK(devregistry_lookup(&dr, name, &device) == 1);
+
+    devregistry_destroy(&dr);
+}
+
+/*
+ * Round-trip samples are smoothed as RFC 6298 does.
+ */
+static void check_rtt(void)
+{
+    struct devregistry dr;
+    struct ddsmgr_device device;
+
+    CHECK(devregistry_initialize(&dr, DR_BUCKETS) == 0);
+
+    CHECK(devregistry_rtt_sample(&dr, "dev0", 1000, 0) == 1);
+    CHECK(devregistry_update(&dr, "dev0", 1, 0, "eth0") == 0);
+    CHECK(devregistry_lookup(&dr, "dev0", &device) == 0);
+    CHECK(device.srtt_ns == 0 && device.rttvar_ns == 0);
+
+    CHECK(devregistry_rtt_sample(&dr, "dev0", 1000, 0) == 0);
+    CHECK(devregistry_lookup(&dr, "dev0", &device) == 0);
+    CHECK(device.srtt_ns == 1000 && device.rttvar_ns == 500);
+
+    CHECK(devregistry_rtt_sample(&dr, "dev0", 2000, 0) == 0);
+    CHECK(devregistry_lookup(&dr, "dev0", &device) == 0);
+    CHECK(device.srtt_ns == 1000 - 125 + 250);
+    CHECK(device.rttvar_ns == 500 - 125 + 250);
+
+    /* A later pong keeps the estimate. */
+    CHECK(devregistry_update(&dr, "dev0", 2, 0, "eth0") == 0);
+    CHECK(devregistry_lookup(&dr, "dev0", &device) == 0);
+    CHECK(device.srtt_ns == 1125);
+
+    /* The first command sample replaces the ping estimate... */
+    CHECK(devregistry_rtt_sample(&dr, "dev0", 8000, 1) == 0);
+    CHECK(devregistry_lookup(&dr, "dev0", &device) == 0);
+    CHECK(device.srtt_ns == 8000 && device.rttvar_ns == 4000);
+
+    /* ...and pings no longer move it. */
+    CHECK(devregistry_rtt_sample(&dr, "dev0", 1000, 0) == 0);
+    CHECK(devregistry_lookup(&dr, "dev0", &device) == 0);
+    CHECK(device.srtt_ns == 8000 && device.rttvar_ns == 4000);
+
+    CHECK(devregistry_rtt_sample(&dr, "dev0", 16000, 1) == 0);
+    CHECK(devregistry_lookup(&dr, "dev0", &device) == 0);
+    CHECK(device.srtt_ns == 8000 - 1000 + 2000);
+
+    devregistry_destroy(&dr);
+}
+
+void check_devregistry(void)
+{
+    check_updates();
+    check_long_names();
+    check_rtt();
+}
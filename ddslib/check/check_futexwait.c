@@ -0,0 +1,113 @@
+#include <pthread.h>
+#include <unistd.h>
+#include "check.h"
+#include "futexwait.h"
+
+#define FW_WAITERS 4
+
+struct waiter {
+    struct futexwait *futexwait;
+    atomic_int *flag;
+    int result;
+};
+
+/*
+ * Waits the way ddslib callers do: re-check the condition after every
+ * return that is not a timeout.
+ */
+static void *wait_flag(void *arg)
+{
+    struct waiter *waiter = arg;
+    struct abs_timeout timo;
+    unsigned int seq;
+
+    check_deadline(&timo, 2000);
+    waiter->result = 0;
+    for (;;)
+    {
+        seq = futexwait_prepare(waiter->futexwait);
+        if (atomic_load(waiter->flag))
+        {
+            break;
+        }
+        if (futexwait_wait(waiter->futexwait, seq, &timo))
+        {
+            waiter->result = 1;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void check_wakeups(void)
+{
+    struct futexwait fw;
+    struct abs_timeout timo;
+    unsigned int seq;
+
+    futexwait_initialize(&fw);
+
+    /* Nothing moves the counter, so the wait runs into its deadline. */
+    seq = futexwait_prepare(&fw);
+    check_deadline(&timo, 10);
+    CHECK(futexwait_wait(&fw, seq, &timo) == 1);
+
+    /* A wake between the prepare and the wait is not lost. */
+    seq = futexwait_prepare(&fw);
+    futexwait_wake(&fw);
+    check_deadline(&timo, 2000);
+    CHECK(futexwait_wait(&fw, seq, &timo) == 0);
+    CHECK(futexwait_prepare(&fw) != seq);
+
+    /* A deadline already in the past returns at once. */
+    seq = futexwait_prepare(&fw);
+    check_deadline(&timo, 0);
+    CHECK(futexwait_wait(&fw, seq, &timo) == 1);
+}
+
+static void check_parked(void)
+{
+    struct futexwait fw;
+    struct waiter waiters[FW_WAITERS];
+    pthread_t threads[FW_WAITERS];
+    atomic_int flag;
+    int i, tries;
+
+    futexwait_initialize(&fw);
+    atomic_init(&flag, 0);
+
+    for (i = 0; i < FW_WAITERS; i++)
+    {
+        waiters[i].futexwait = &fw;
+        waiters[i].flag = &flag;
+        pthread_create(&threads[i], NULL, wait_flag, &waiters[i]);
+    }
+
+    /* Let every waiter get past its spin and into the kernel. */
+    for (tries = 0; tries < 1000; tries++)
+    {
+        if (atomic_load(&fw.parked) == FW_WAITERS)
+        {
+            break;
+        }
+        usleep(1000);
+    }
+    CHECK(atomic_load(&fw.parked) == FW_WAITERS);
+
+    /* One wake releases every parked waiter well before the deadline. */
+    atomic_store(&flag, 1);
+    futexwait_wake(&fw);
+    for (i = 0; i < FW_WAITERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+        CHECK(waiters[i].result == 0);
+    }
+    CHECK(atomic_load(&fw.parked) == 0);
+}
+
+void check_futexwait(void)
+{
+    check_wakeups();
+    check_parked();
+}
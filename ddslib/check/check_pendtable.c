@@ -0,0 +1,363 @@
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "check.h"
+#include "epstats.h"
+#include "pendtable.h"
+
+#define PT_BUCKETS 8
+#define PT_WAITERS 16
+#define PT_ROUNDS 200
+
+struct ptslot {
+    int request_id;
+    int value;
+};
+
+struct ptwaiter {
+    struct pendtable *pt;
+    int request_id;
+    int registered;
+    int mismatched;
+};
+
+static int discarded;
+
+static void convert_slot(void *arg, void *dst, void *src)
+{
+    ((struct ptslot *)dst)->value = *(int *)src;
+}
+
+static void discard_slot(void *arg, void *data)
+{
+    discarded++;
+}
+
+/* Records in the slot whether the table lock was free during convert(). */
+static void convert_unlocked(void *arg, void *dst, void *src)
+{
+    struct pendtable *pt;
+
+    pt = arg;
+    ((struct ptslot *)dst)->value = pthread_mutex_trylock(&pt->mutex) == 0;
+    if (((struct ptslot *)dst)->value)
+    {
+        pthread_mutex_unlock(&pt->mutex);
+    }
+}
+
+static int produce(struct pendtable *pt, int request_id, int value)
+{
+    return pendtable_produce(pt, request_id, &value);
+}
+
+static int register_id(struct pendtable *pt, int request_id, int pollable)
+{
+    struct ptslot slot;
+
+    slot.request_id = request_id;
+    slot.value = -1;
+
+    return pendtable_register(pt, request_id, &slot, pollable);
+}
+
+static int readable(int fd)
+{
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    return poll(&pfd, 1, 0) == 1;
+}
+
+static void check_demux(void)
+{
+    struct pendtable pt;
+    struct epstats stats;
+    struct abs_timeout timo;
+    struct ptslot slot;
+
+    epstats_initialize(&stats);
+    discarded = 0;
+    CHECK(pendtable_initialize(&pt, PT_BUCKETS, sizeof(slot), convert_slot,
+                               discard_slot, NULL, &stats) == 0);
+
+    /* Ids that share a bucket still get their own results. */
+    CHECK(register_id(&pt, 1, 0) == 0);
+    CHECK(register_id(&pt, 1 + PT_BUCKETS, 0) == 0);
+    CHECK(register_id(&pt, 1, 0) == PENDTABLE_EXISTS);
+    CHECK(produce(&pt, 1 + PT_BUCKETS, 20) == 0);
+    CHECK(produce(&pt, 1, 10) == 0);
+
+    check_deadline(&timo, 1000);
+    CHECK(pendtable_consume(&pt, 1, &slot, &timo) == 0);
+    CHECK(slot.request_id == 1 && slot.value == 10);
+    CHECK(pendtable_consume(&pt, 1 + PT_BUCKETS, &slot, &timo) == 0);
+    CHECK(slot.request_id == 1 + PT_BUCKETS && slot.value == 20);
+
+    /* A result is handed out once. */
+    CHECK(pendtable_consume(&pt, 1, &slot, &timo) == 1);
+
+    /* Unknown ids and second responses are dropped and counted. */
+    CHECK(produce(&pt, 3, 30) == 1);
+    CHECK(stats.dropped_unknown == 1);
+    CHECK(produce(&pt, 1, 11) == 1);
+    CHECK(stats.dropped_duplicate == 1);
+
+    /* A waiter on an unanswered id times out. */
+    CHECK(register_id(&pt, 4, 0) == 0);
+    check_deadline(&timo, 10);
+    CHECK(pendtable_consume(&pt, 4, &slot, &timo) == 1);
+    CHECK(stats.timeouts == 1);
+
+    /* An unclaimed result is discarded, and counted as nobody's, with its
+     * request; a claimed one belongs to the consumer. */
+    CHECK(produce(&pt, 4, 40) == 0);
+    pendtable_unregister(&pt, 4);
+    pendtable_unregister(&pt, 1);
+    CHECK(discarded == 1);
+    CHECK(stats.dropped_unknown == 2);
+    CHECK(produce(&pt, 4, 41) == 1);
+    CHECK(stats.dropped_unknown == 3);
+
+    pendtable_unregister(&pt, 1 + PT_BUCKETS);
+    pendtable_destroy(&pt);
+}
+
+static void check_ready_list(void)
+{
+    struct pendtable pt;
+    struct epstats stats;
+    struct abs_timeout timo;
+    struct ptslot slot;
+
+    epstats_initialize(&stats);
+    discarded = 0;
+    CHECK(pendtable_initialize(&pt, PT_BUCKETS, sizeof(slot), convert_slot,
+                               discard_slot, NULL, &stats) == 0);
+
+    CHECK(register_id(&pt, 1, 1) == 0);
+    CHECK(register_id(&pt, 2, 1) == 0);
+    CHECK(register_id(&pt, 3, 0) == 0);
+    CHECK(!readable(pendtable_fd(&pt)));
+
+    /* Pollable results come out in completion order; others only to
+     * their own waiter. */
+    CHECK(produce(&pt, 3, 30) == 0);
+    CHECK(produce(&pt, 2, 20) == 0);
+    CHECK(produce(&pt, 1, 10) == 0);
+    CHECK(readable(pendtable_fd(&pt)));
+    CHECK(pendtable_tryconsume(&pt, &slot) == 0 && slot.value == 20);
+    CHECK(pendtable_tryconsume(&pt, &slot) == 0 && slot.value == 10);
+    CHECK(pendtable_tryconsume(&pt, &slot) == 1);
+    check_deadline(&timo, 1000);
+    CHECK(pendtable_consume(&pt, 3, &slot, &timo) == 0 && slot.value == 30);
+
+    /* Unregistering takes a completed entry off the ready list. */
+    CHECK(register_id(&pt, 4, 1) == 0);
+    CHECK(produce(&pt, 4, 40) == 0);
+    pendtable_unregister(&pt, 4);
+    CHECK(pendtable_tryconsume(&pt, &slot) == 1);
+    CHECK(discarded == 1);
+
+    pendtable_unregister(&pt, 1);
+    pendtable_unregister(&pt, 2);
+    pendtable_unregister(&pt, 3);
+    pendtable_destroy(&pt);
+}
+
+static void *wait_own(void *arg)
+{
+    struct ptwaiter *waiter;
+    struct abs_timeout timo;
+    struct ptslot slot;
+    int round;
+
+    waiter = arg;
+
+    for (round = 0; round < PT_ROUNDS; round++)
+    {
+        while (!__atomic_load_n(&waiter->registered, __ATOMIC_ACQUIRE))
+        {
+        }
+        check_deadline(&timo, 2000);
+        if (pendtable_consume(waiter->pt, waiter->request_id, &slot,
+                              &timo) != 0 ||
+            slot.value != waiter->request_id * PT_ROUNDS + round)
+        {
+            waiter->mismatched++;
+        }
+        pendtable_unregister(waiter->pt, waiter->request_id);
+        __atomic_store_n(&waiter->registered, 0, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+/*
+ * Concurrent waiters each get the response to their own id, whatever
+ * order the responses arrive in.
+ */
+static void check_concurrent(void)
+{
+    struct pendtable pt;
+    struct epstats stats;
+    struct ptwaiter waiters[PT_WAITERS];
+    pthread_t threads[PT_WAITERS];
+    int order[PT_WAITERS];
+    int round, i, j, tmp, mismatched;
+
+    epstats_initialize(&stats);
+    CHECK(pendtable_initialize(&pt, PT_BUCKETS, sizeof(struct ptslot),
+                               convert_slot, discard_slot, NULL,
+                               &stats) == 0);
+
+    for (i = 0; i < PT_WAITERS; i++)
+    {
+        waiters[i].pt = &pt;
+        waiters[i].request_id = i + 1;
+        waiters[i].registered = 0;
+        waiters[i].mismatched = 0;
+        order[i] = i;
+        pthread_create(&threads[i], NULL, wait_own, &waiters[i]);
+    }
+
+    srand(1);
+    for (round = 0; round < PT_ROUNDS; round++)
+    {
+        for (i = 0; i < PT_WAITERS; i++)
+        {
+            while (__atomic_load_n(&waiters[i].registered, __ATOMIC_ACQUIRE))
+            {
+            }
+            register_id(&pt, waiters[i].request_id, 0);
+            __atomic_store_n(&waiters[i].registered, 1, __ATOMIC_RELEASE);
+        }
+        for (i = PT_WAITERS - 1; i > 0; i--)
+        {
+            j = rand() % (i + 1);
+            tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+        for (i = 0; i < PT_WAITERS; i++)
+        {
+            j = waiters[order[i]].request_id;
+            produce(&pt, j, j * PT_ROUNDS + round);
+        }
+    }
+
+    mismatched = 0;
+    for (i = 0; i < PT_WAITERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+        mismatched += waiters[i].mismatched;
+    }
+    CHECK(mismatched == 0);
+    CHECK(stats.converted == PT_WAITERS * PT_ROUNDS);
+    CHECK(stats.dropped_unknown == 0);
+
+    pendtable_destroy(&pt);
+}
+
+static void *consume_one(void *arg)
+{
+    struct ptwaiter *waiter;
+    struct abs_timeout timo;
+    struct ptslot slot;
+
+    waiter = arg;
+
+    check_deadline(&timo, 2000);
+    waiter->mismatched = pendtable_consume(waiter->pt, waiter->request_id,
+                                           &slot, &timo);
+
+    return NULL;
+}
+
+/*
+ * Unregistering a request whose consumer is parked wakes that consumer
+ * with a failure, and the entry outlives the wait.
+ */
+static void check_unregister_waiting(void)
+{
+    struct pendtable pt;
+    struct epstats stats;
+    struct ptwaiter waiter;
+    struct timespec start, end;
+    pthread_t thread;
+    unsigned int refs;
+
+    epstats_initialize(&stats);
+    CHECK(pendtable_initialize(&pt, PT_BUCKETS, sizeof(struct ptslot),
+                               convert_slot, discard_slot, NULL,
+                               &stats) == 0);
+    CHECK(register_id(&pt, 1, 0) == 0);
+
+    waiter.pt = &pt;
+    waiter.request_id = 1;
+    waiter.mismatched = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&thread, NULL, consume_one, &waiter);
+
+    /* The consumer's reference shows that it is waiting. */
+    do
+    {
+        pthread_mutex_lock(&pt.mutex);
+        refs = pt.buckets[1]->refs;
+        pthread_mutex_unlock(&pt.mutex);
+    } while (refs != 2);
+
+    pendtable_unregister(&pt, 1);
+    pthread_join(thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    CHECK(waiter.mismatched == 1);
+    CHECK((end.tv_sec - start.tv_sec) * 1000 +
+          (end.tv_nsec - start.tv_nsec) / 1000000 < 1000);
+    CHECK(stats.timeouts == 0);
+    CHECK(produce(&pt, 1, 10) == 1);
+    CHECK(stats.dropped_unknown == 1);
+
+    pendtable_destroy(&pt);
+}
+
+/*
+ * convert() runs without the table lock, and a second sample for the same
+ * request is a duplicate even while the first is being converted.
+ */
+static void check_convert_unlocked(void)
+{
+    struct pendtable pt;
+    struct epstats stats;
+    struct abs_timeout timo;
+    struct ptslot slot;
+
+    epstats_initialize(&stats);
+    CHECK(pendtable_initialize(&pt, PT_BUCKETS, sizeof(struct ptslot),
+                               convert_unlocked, discard_slot, &pt,
+                               &stats) == 0);
+    CHECK(register_id(&pt, 1, 0) == 0);
+
+    CHECK(produce(&pt, 1, 0) == 0);
+    CHECK(produce(&pt, 1, 0) == 1);
+    CHECK(stats.dropped_duplicate == 1);
+
+    check_deadline(&timo, 100);
+    CHECK(pendtable_consume(&pt, 1, &slot, &timo) == 0);
+    CHECK(slot.value == 1);
+
+    pendtable_unregister(&pt, 1);
+    pendtable_destroy(&pt);
+}
+
+void check_pendtable(void)
+{
+    check_demux();
+    check_ready_list();
+    check_concurrent();
+    check_unregister_waiting();
+    check_convert_unlocked();
+}
@@ -0,0 +1,267 @@
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include "check.h"
+#include "pubqueue.h"
+
+#define PQ_DEPTH 4
+#define PQ_BUFSIZE 8
+#define PQ_PRODUCERS 4
+#define PQ_SAMPLES 500
+
+/*
+ * What the writer published, in order.  Every payload is the request id
+ * repeated, so each sample can be checked for its own data.  Publishing
+ * blocks while the gate is closed.
+ */
+struct pqrecord {
+    int ids[PQ_PRODUCERS * PQ_SAMPLES];
+    int count;
+    int corrupt;
+    int statuses;
+    atomic_int gate;
+    atomic_int entered;
+};
+
+static void fill(char *payload, int request_id, int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+    {
+        payload[i] = (char)(request_id + i);
+    }
+}
+
+static int publish(void *arg, const struct pubsample *sample)
+{
+    struct pqrecord *record = arg;
+    char expected[64];
+
+    atomic_fetch_add(&record->entered, 1);
+    while (!atomic_load(&record->gate))
+    {
+        usleep(100);
+    }
+
+    fill(expected, sample->request_id, sample->size);
+    if (sample->data == NULL ||
+        memcmp(sample->data, expected, sample->size) != 0)
+    {
+        record->corrupt++;
+    }
+    record->ids[record->count++] = sample->request_id;
+
+    /* Odd ids fail to publish, to check the status reaches the poster. */
+    return sample->request_id & 1;
+}
+
+static void posted(void *arg, int request_id, int status)
+{
+    struct pqrecord *record = arg;
+
+    if (status == (request_id & 1))
+    {
+        record->statuses++;
+    }
+}
+
+static int post(struct pubqueue *pq,
+                struct pqrecord *record,
+                int request_id,
+                int size,
+                unsigned long long *token)
+{
+    struct pubsample sample;
+    char payload[64];
+
+    fill(payload, request_id, size);
+    memset(&sample, 0, sizeof(sample));
+    sample.type = PUBTYPE_MCMD;
+    sample.request_id = request_id;
+    strcpy(sample.device_name, "loop0");
+    sample.data = payload;
+    sample.size = size;
+    sample.posted = posted;
+    sample.arg = record;
+
+    return pubqueue_post(pq, &sample, token);
+}
+
+static void record_init(struct pqrecord *record, int open)
+{
+    memset(record->ids, 0, sizeof(record->ids));
+    record->count = 0;
+    record->corrupt = 0;
+    record->statuses = 0;
+    atomic_init(&record->gate, open);
+    atomic_init(&record->entered, 0);
+}
+
+static void check_order(void)
+{
+    struct pubqueue pq;
+    struct pqrecord record;
+    struct abs_timeout timo;
+    unsigned long long token, last;
+    int i;
+
+    record_init(&record, 0);
+    CHECK(pubqueue_initialize(&pq, PQ_DEPTH, PQ_BUFSIZE, publish,
+                              &record) == 0);
+
+    /* Tokens count posts from one; the writer holds on to the first. */
+    CHECK(post(&pq, &record, 0, 3, &token) == 0 && token == 1);
+    while (atomic_load(&record.entered) == 0)
+    {
+        usleep(100);
+    }
+
+    /* Payloads larger than bufsize are carried on the heap. */
+    for (i = 1; i < PQ_DEPTH; i++)
+    {
+        CHECK(post(&pq, &record, i, i == 2 ? 40 : PQ_BUFSIZE,
+                   &last) == 0);
+    }
+    CHECK(last == PQ_DEPTH);
+
+    /* Every slot is taken, so the post is refused rather than blocked. */
+    CHECK(post(&pq, &record, 99, 1, NULL) == 1);
+
+    check_deadline(&timo, 10);
+    CHECK(pubqueue_wait(&pq, token, &timo) == 1);
+
+    atomic_store(&record.gate, 1);
+    check_deadline(&timo, 2000);
+    CHECK(pubqueue_wait(&pq, last, &timo) == 0);
+
+    CHECK(record.count == PQ_DEPTH);
+    for (i = 0; i < record.count; i++)
+    {
+        CHECK(record.ids[i] == i);
+    }
+    CHECK(record.corrupt == 0);
+    CHECK(record.statuses == PQ_DEPTH);
+
+    /* A token already reached returns at once. */
+    check_deadline(&timo, 0);
+    CHECK(pubqueue_wait(&pq, token, &timo) == 0);
+
+    pubqueue_destroy(&pq);
+}
+
+static void *open_gate_later(void *arg)
+{
+    struct pqrecord *record = arg;
+
+    usleep(20000);
+    atomic_store(&record->gate, 1);
+
+    return NULL;
+}
+
+static void check_destroy(void)
+{
+    struct pubqueue pq;
+    struct pqrecord record;
+    pthread_t thread;
+    int i;
+
+    record_init(&record, 0);
+    CHECK(pubqueue_initialize(&pq, PQ_DEPTH, PQ_BUFSIZE, publish,
+                              &record) == 0);
+
+    for (i = 0; i < PQ_DEPTH; i++)
+    {
+        CHECK(post(&pq, &record, i, 20, NULL) == 0);
+    }
+
+    /* Destroying publishes what is queued, and frees the heap payloads. */
+    pthread_create(&thread, NULL, open_gate_later, &record);
+    pubqueue_destroy(&pq);
+    pthread_join(thread, NULL);
+
+    CHECK(record.count == PQ_DEPTH);
+    CHECK(record.corrupt == 0);
+}
+
+struct pqproducer {
+    struct pubqueue *pq;
+    struct pqrecord *record;
+    int first;
+    unsigned long long token;
+};
+
+static void *produce(void *arg)
+{
+    struct pqproducer *producer = arg;
+    int i;
+
+    for (i = 0; i < PQ_SAMPLES; i++)
+    {
+        while (post(producer->pq, producer->record, producer->first + i,
+                    i % 24, &producer->token))
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void check_producers(void)
+{
+    struct pubqueue pq;
+    struct pqrecord record;
+    struct pqproducer producers[PQ_PRODUCERS];
+    pthread_t threads[PQ_PRODUCERS];
+    struct abs_timeout timo;
+    int next[PQ_PRODUCERS];
+    int i, p;
+
+    record_init(&record, 1);
+    CHECK(pubqueue_initialize(&pq, PQ_DEPTH, PQ_BUFSIZE, publish,
+                              &record) == 0);
+
+    for (p = 0; p < PQ_PRODUCERS; p++)
+    {
+        producers[p].pq = &pq;
+        producers[p].record = &record;
+        producers[p].first = p * PQ_SAMPLES;
+        pthread_create(&threads[p], NULL, produce, &producers[p]);
+    }
+    for (p = 0; p < PQ_PRODUCERS; p++)
+    {
+        pthread_join(threads[p], NULL);
+        check_deadline(&timo, 2000);
+        CHECK(pubqueue_wait(&pq, producers[p].token, &timo) == 0);
+    }
+
+    /* Nothing is lost or duplicated, and each producer keeps its order. */
+    CHECK(record.count == PQ_PRODUCERS * PQ_SAMPLES);
+    CHECK(record.corrupt == 0);
+    CHECK(record.statuses == PQ_PRODUCERS * PQ_SAMPLES);
+    for (p = 0; p < PQ_PRODUCERS; p++)
+    {
+        next[p] = p * PQ_SAMPLES;
+    }
+    for (i = 0; i < record.count; i++)
+    {
+        p = record.ids[i] / PQ_SAMPLES;
+        CHECK(p >= 0 && p < PQ_PRODUCERS && record.ids[i] == next[p]);
+        if (p >= 0 && p < PQ_PRODUCERS)
+        {
+            next[p]++;
+        }
+    }
+
+    pubqueue_destroy(&pq);
+}
+
+void check_pubqueue(void)
+{
+    check_order();
+    check_destroy();
+    check_producers();
+}
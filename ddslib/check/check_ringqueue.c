@@ -0,0 +1,133 @@
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "check.h"
+#include "epstats.h"
+#include "ringqueue.h"
+
+#define RQ_DEPTH 4
+
+static void convert_int(void *dst, void *src)
+{
+    *(int *)dst = *(int *)src;
+}
+
+static int produce(struct ringqueue *rq, int value)
+{
+    return ringqueue_produce(rq, &value);
+}
+
+static void *produce_later(void *arg)
+{
+    usleep(20000);
+    produce(arg, 42);
+
+    return NULL;
+}
+
+static void *reject_later(void *arg)
+{
+    usleep(20000);
+    ringqueue_reject(arg);
+
+    return NULL;
+}
+
+static int readable(int fd)
+{
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    return poll(&pfd, 1, 0) == 1;
+}
+
+static void check_order(void)
+{
+    struct ringqueue rq;
+    struct epstats stats;
+    int value, i;
+
+    epstats_initialize(&stats);
+    CHECK(ringqueue_initialize(&rq, RQ_DEPTH, sizeof(int), convert_int,
+                               &stats) == 0);
+
+    /* Nothing is queued before the consumer listens. */
+    CHECK(produce(&rq, 1) == 1);
+    CHECK(stats.dropped_disabled == 1);
+
+    ringqueue_listen(&rq);
+    CHECK(!readable(ringqueue_fd(&rq)));
+    for (i = 0; i < RQ_DEPTH; i++)
+    {
+        CHECK(produce(&rq, i) == 0);
+    }
+    CHECK(readable(ringqueue_fd(&rq)));
+
+    /* A full queue drops rather than blocks. */
+    CHECK(produce(&rq, 99) == 1);
+    CHECK(stats.dropped_full == 1);
+
+    /* Samples come out in order across the wrap of the ring. */
+    CHECK(ringqueue_tryconsume(&rq, &value) == 0 && value == 0);
+    CHECK(ringqueue_tryconsume(&rq, &value) == 0 && value == 1);
+    CHECK(produce(&rq, 4) == 0);
+    CHECK(produce(&rq, 5) == 0);
+    for (i = 2; i < 6; i++)
+    {
+        CHECK(ringqueue_tryconsume(&rq, &value) == 0 && value == i);
+    }
+    CHECK(ringqueue_tryconsume(&rq, &value) == 1);
+    CHECK(stats.converted == RQ_DEPTH + 2);
+
+    ringqueue_destroy(&rq);
+}
+
+static void check_blocking(void)
+{
+    struct ringqueue rq;
+    struct epstats stats;
+    struct abs_timeout timo;
+    pthread_t thread;
+    int value;
+
+    epstats_initialize(&stats);
+    CHECK(ringqueue_initialize(&rq, RQ_DEPTH, sizeof(int), convert_int,
+                               &stats) == 0);
+    ringqueue_listen(&rq);
+
+    /* An empty queue times out and counts it. */
+    check_deadline(&timo, 10);
+    CHECK(ringqueue_consume(&rq, &value, &timo) == 1);
+    CHECK(stats.timeouts == 1);
+
+    /* A parked consumer is woken by the producer. */
+    value = 0;
+    pthread_create(&thread, NULL, produce_later, &rq);
+    check_deadline(&timo, 2000);
+    CHECK(ringqueue_consume(&rq, &value, &timo) == 0 && value == 42);
+    pthread_join(thread, NULL);
+
+    /* Rejecting drops what is queued and releases a parked consumer. */
+    CHECK(produce(&rq, 7) == 0);
+    CHECK(produce(&rq, 8) == 0);
+    ringqueue_reject(&rq);
+    CHECK(stats.dropped_disabled == 2);
+    CHECK(ringqueue_tryconsume(&rq, &value) == 1);
+
+    ringqueue_listen(&rq);
+    pthread_create(&thread, NULL, reject_later, &rq);
+    check_deadline(&timo, 2000);
+    CHECK(ringqueue_consume(&rq, &value, &timo) == 1);
+    CHECK(stats.timeouts == 1);
+    pthread_join(thread, NULL);
+
+    ringqueue_destroy(&rq);
+}
+
+void check_ringqueue(void)
+{
+    check_order();
+    check_blocking();
+}
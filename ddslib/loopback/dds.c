@@ -0,0 +1,434 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dds.h"
+
+enum loopevtype {
+    LOOPEVTYPE_MATCH,
+    LOOPEVTYPE_MRSP,
+    LOOPEVTYPE_PONG,
+};
+
+struct dds_participant {
+    int segment;
+    struct dds_participant_listener listener;
+};
+
+struct loopevent {
+    struct loopevent *next;
+    struct timespec due;
+    enum loopevtype type;
+    dds_participant *participant;
+    void (*matched)(void *arg);
+    PacketMRsp mrsp;
+    PacketPong pong;
+};
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t condvar;
+    pthread_t thread;
+    int started;
+    struct loopevent *head;
+    struct loopevent **tail;
+    int num_devices;
+    int num_segments;
+    int num_participants;
+    unsigned int latency_us;
+} loopback = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .condvar = PTHREAD_COND_INITIALIZER,
+    .num_devices = 1,
+    .num_segments = 1,
+};
+
+/* Callbacks of the single participant created through dds_create(). */
+static struct {
+    dds_participant *participant;
+    void (*mrsp_matched)(void);
+    void (*mrsp_received)(PacketMRsp *mrsp);
+    void (*pong_matched)(void);
+    void (*pong_received)(PacketPong *pong);
+    void (*mcmd_matched)(void);
+    void (*ping_matched)(void);
+} legacy;
+
+unsigned int DDS_CharSeq_get_length(const DDS_CharSeq *seq)
+{
+    return seq->length;
+}
+
+int DDS_CharSeq_to_array(const DDS_CharSeq *seq,
+                         DDS_Char *array,
+                         unsigned int length)
+{
+    if (length > seq->length)
+    {
+        return 1;
+    }
+
+    memcpy(array, seq->buffer, length);
+
+    return 0;
+}
+
+static void loopback_post(struct loopevent *event)
+{
+    clock_gettime(CLOCK_MONOTONIC, &event->due);
+    event->due.tv_nsec += (long)loopback.latency_us * 1000;
+    event->due.tv_sec += event->due.tv_nsec / 1000000000;
+    event->due.tv_nsec %= 1000000000;
+    event->next = NULL;
+
+    pthread_mutex_lock(&loopback.mutex);
+    *loopback.tail = event;
+    loopback.tail = &event->next;
+    pthread_mutex_unlock(&loopback.mutex);
+
+    pthread_cond_signal(&loopback.condvar);
+}
+
+static void loopback_deliver(struct loopevent *event)
+{
+    struct dds_participant_listener *listener;
+
+    listener = &event->participant->listener;
+
+    switch (event->type)
+    {
+    case LOOPEVTYPE_MATCH:
+        if (event->matched != NULL)
+        {
+            event->matched(listener->arg);
+        }
+        break;
+
+    case LOOPEVTYPE_MRSP:
+        if (listener->mrsp_received != NULL)
+        {
+            listener->mrsp_received(listener->arg, &event->mrsp);
+        }
+        free(event->mrsp.rsp_data.buffer);
+        break;
+
+    case LOOPEVTYPE_PONG:
+        if (listener->pong_received != NULL)
+        {
+            listener->pong_received(listener->arg, &event->pong);
+        }
+        break;
+    }
+
+    free(event);
+}
+
+static void *loopback_listener(void *arg)
+{
+    struct loopevent *event;
+    struct timespec due;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&loopback.mutex);
+        while (loopback.head == NULL)
+        {
+            pthread_cond_wait(&loopback.condvar, &loopback.mutex);
+        }
+        event = loopback.head;
+        loopback.head = event->next;
+        if (loopback.head == NULL)
+        {
+            loopback.tail = &loopback.head;
+        }
+        pthread_mutex_unlock(&loopback.mutex);
+
+        if (loopback.latency_us)
+        {
+            due = event->due;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                   &due, NULL) != 0)
+            {
+            }
+        }
+
+        loopback_deliver(event);
+    }
+
+    return NULL;
+}
+
+static void loopback_post_match(dds_participant *participant,
+                                void (*matched)(void *arg))
+{
+    struct loopevent *event;
+
+    event = calloc(1, sizeof(*event));
+    if (event == NULL)
+    {
+        return;
+    }
+
+    event->type = LOOPEVTYPE_MATCH;
+    event->participant = participant;
+    event->matched = matched;
+    loopback_post(event);
+}
+
+/*
+ * Returns the index of the simulated device with the given name if the
+ * participant can reach it, or -1.
+ */
+static int loopback_device_index(dds_participant *participant,
+                                 const char *device_name)
+{
+    char *end;
+    long index;
+
+    if (strncmp(device_name, "loop", 4) != 0)
+    {
+        return -1;
+    }
+
+    index = strtol(device_name + 4, &end, 10);
+    if (end == device_name + 4 || *end != '\0' ||
+        index < 0 || index >= loopback.num_devices ||
+        index % loopback.num_segments != participant->segment)
+    {
+        return -1;
+    }
+
+    return index;
+}
+
+void dds_loopback_configure(int num_devices,
+                            int num_segments,
+                            unsigned int latency_us)
+{
+    loopback.num_devices = num_devices;
+    loopback.num_segments = num_segments > 0 ? num_segments : 1;
+    loopback.latency_us = latency_us;
+}
+
+dds_participant *dds_participant_create(
+    int (*print_error)(const char *fmt, ...),
+    uint32_t address,
+    uint32_t netmask,
+    const struct dds_participant_listener *listener)
+{
+    dds_participant *participant;
+
+    participant = calloc(1, sizeof(*participant));
+    if (participant == NULL)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&loopback.mutex);
+    if (!loopback.started)
+    {
+        loopback.tail = &loopback.head;
+        if (pthread_create(&loopback.thread, NULL,
+                           loopback_listener, NULL) != 0)
+        {
+            pthread_mutex_unlock(&loopback.mutex);
+            free(participant);
+            return NULL;
+        }
+        loopback.started = 1;
+    }
+    participant->segment = loopback.num_participants++ %
+                           loopback.num_segments;
+    pthread_mutex_unlock(&loopback.mutex);
+
+    participant->listener = *listener;
+
+    return participant;
+}
+
+int dds_participant_enable(dds_participant *participant)
+{
+    loopback_post_match(participant, participant->listener.ping_matched);
+    loopback_post_match(participant, participant->listener.pong_matched);
+    loopback_post_match(participant, participant->listener.mcmd_matched);
+    loopback_post_match(participant, participant->listener.mrsp_matched);
+
+    return 0;
+}
+
+int dds_participant_mcmd_publish(dds_participant *participant,
+                                 int request_id,
+                                 const char *device_name,
+                                 const char *cmd_data,
+                                 int cmd_size)
+{
+    struct loopevent *event;
+
+    if (loopback_device_index(participant, device_name) < 0)
+    {
+        return 0;
+    }
+
+    event = calloc(1, sizeof(*event));
+    if (event == NULL)
+    {
+        return 1;
+    }
+
+    event->mrsp.rsp_data.buffer = malloc(cmd_size ? cmd_size : 1);
+    if (event->mrsp.rsp_data.buffer == NULL)
+    {
+        free(event);
+        return 1;
+    }
+
+    event->type = LOOPEVTYPE_MRSP;
+    event->participant = participant;
+    event->mrsp.request_id = request_id;
+    event->mrsp.rsp_data.length = cmd_size;
+    memcpy(event->mrsp.rsp_data.buffer, cmd_data, cmd_size);
+    loopback_post(event);
+
+    return 0;
+}
+
+int dds_participant_ping_publish(dds_participant *participant,
+                                 int request_id)
+{
+    struct loopevent *event;
+    int i;
+
+    for (i = participant->segment;
+         i < loopback.num_devices;
+         i += loopback.num_segments)
+    {
+        event = calloc(1, sizeof(*event));
+        if (event == NULL)
+        {
+            return 1;
+        }
+
+        event->type = LOOPEVTYPE_PONG;
+        event->participant = participant;
+        event->pong.request_id = request_id;
+        snprintf(event->pong.device_name, sizeof(event->pong.device_name),
+                 "loop%d", i);
+        loopback_post(event);
+    }
+
+    return 0;
+}
+
+static void legacy_matched(void (*matched)(void))
+{
+    if (matched != NULL)
+    {
+        matched();
+    }
+}
+
+static void legacy_mrsp_matched(void *arg)
+{
+    legacy_matched(legacy.mrsp_matched);
+}
+
+static void legacy_mrsp_received(void *arg, PacketMRsp *mrsp)
+{
+    if (legacy.mrsp_received != NULL)
+    {
+        legacy.mrsp_received(mrsp);
+    }
+}
+
+static void legacy_pong_matched(void *arg)
+{
+    legacy_matched(legacy.pong_matched);
+}
+
+static void legacy_pong_received(void *arg, PacketPong *pong)
+{
+    if (legacy.pong_received != NULL)
+    {
+        legacy.pong_received(pong);
+    }
+}
+
+static void legacy_mcmd_matched(void *arg)
+{
+    legacy_matched(legacy.mcmd_matched);
+}
+
+static void legacy_ping_matched(void *arg)
+{
+    legacy_matched(legacy.ping_matched);
+}
+
+int dds_create(int (*print_error)(const char *fmt, ...),
+               uint32_t address,
+               uint32_t netmask)
+{
+    struct dds_participant_listener listener;
+
+    listener.arg = NULL;
+    listener.mrsp_matched = legacy_mrsp_matched;
+    listener.mrsp_received = legacy_mrsp_received;
+    listener.pong_matched = legacy_pong_matched;
+    listener.pong_received = legacy_pong_received;
+    listener.mcmd_matched = legacy_mcmd_matched;
+    listener.ping_matched = legacy_ping_matched;
+
+    legacy.participant = dds_participant_create(print_error, address,
+                                                netmask, &listener);
+
+    return legacy.participant == NULL;
+}
+
+int dds_mrsp_subscriber(void (*matched)(void),
+                        void (*received)(PacketMRsp *mrsp))
+{
+    legacy.mrsp_matched = matched;
+    legacy.mrsp_received = received;
+
+    return 0;
+}
+
+int dds_pong_subscriber(void (*matched)(void),
+                        void (*received)(PacketPong *pong))
+{
+    legacy.pong_matched = matched;
+    legacy.pong_received = received;
+
+    return 0;
+}
+
+int dds_mcmd_publisher(void (*matched)(void))
+{
+    legacy.mcmd_matched = matched;
+
+    return 0;
+}
+
+int dds_ping_publisher(void (*matched)(void))
+{
+    legacy.ping_matched = matched;
+
+    return 0;
+}
+
+int dds_enable(void)
+{
+    return dds_participant_enable(legacy.participant);
+}
+
+int dds_mcmd_publish(int request_id,
+                     const char *device_name,
+                     const char *cmd_data,
+                     int cmd_size)
+{
+    return dds_participant_mcmd_publish(legacy.participant, request_id,
+                                        device_name, cmd_data, cmd_size);
+}
+
+int dds_ping_publish(int request_id)
+{
+    return dds_participant_ping_publish(legacy.participant, request_id);
+}
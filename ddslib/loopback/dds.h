@@ -0,0 +1,104 @@
+#ifndef __LOOPBACK_DDS_H__
+#define __LOOPBACK_DDS_H__
+
+/*
+ * In-process stand-in for the mynewt-dds-micro dds_mgr API that ddsmgr is
+ * built against (lib2/dds.h).  Nothing goes on the wire: published MCmds
+ * and pings are handed to a set of simulated devices, and their MRsps and
+ * pongs are delivered to the subscriber callbacks from a separate listener
+ * thread, as a real participant would.  Every simulated device answers an
+ * MCmd by echoing its payload back.
+ *
+ * Devices are spread over one or more simulated network segments, and
+ * each participant reaches only one segment, so a manager bound to several
+ * interfaces must route every MCmd to the right participant to get an
+ * answer.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef char DDS_Char;
+
+typedef struct {
+    DDS_Char *buffer;
+    unsigned int length;
+} DDS_CharSeq;
+
+unsigned int DDS_CharSeq_get_length(const DDS_CharSeq *seq);
+int DDS_CharSeq_to_array(const DDS_CharSeq *seq,
+                         DDS_Char *array,
+                         unsigned int length);
+
+typedef struct {
+    int request_id;
+    DDS_CharSeq rsp_data;
+} PacketMRsp;
+
+typedef struct {
+    int request_id;
+    char device_name[16];
+} PacketPong;
+
+int dds_create(int (*print_error)(const char *fmt, ...),
+               uint32_t address,
+               uint32_t netmask);
+int dds_mrsp_subscriber(void (*matched)(void),
+                        void (*received)(PacketMRsp *mrsp));
+int dds_pong_subscriber(void (*matched)(void),
+                        void (*received)(PacketPong *pong));
+int dds_mcmd_publisher(void (*matched)(void));
+int dds_ping_publisher(void (*matched)(void));
+int dds_enable(void);
+
+int dds_mcmd_publish(int request_id,
+                     const char *device_name,
+                     const char *cmd_data,
+                     int cmd_size);
+int dds_ping_publish(int request_id);
+
+/*
+ * Multi-participant extension: any number of participants, each bound to
+ * its own interface, with callbacks that carry the listener's arg.
+ */
+#define DDS_MULTI_PARTICIPANT 1
+
+typedef struct dds_participant dds_participant;
+
+struct dds_participant_listener {
+    void *arg;
+    void (*mrsp_matched)(void *arg);
+    void (*mrsp_received)(void *arg, PacketMRsp *mrsp);
+    void (*pong_matched)(void *arg);
+    void (*pong_received)(void *arg, PacketPong *pong);
+    void (*mcmd_matched)(void *arg);
+    void (*ping_matched)(void *arg);
+};
+
+dds_participant *dds_participant_create(
+    int (*print_error)(const char *fmt, ...),
+    uint32_t address,
+    uint32_t netmask,
+    const struct dds_participant_listener *listener);
+int dds_participant_enable(dds_participant *participant);
+int dds_participant_mcmd_publish(dds_participant *participant,
+                                 int request_id,
+                                 const char *device_name,
+                                 const char *cmd_data,
+                                 int cmd_size);
+int dds_participant_ping_publish(dds_participant *participant,
+                                 int request_id);
+
+/*
+ * Loopback controls.  Must be called before the first participant is
+ * created.  Devices are named "loop0", "loop1", ...; device i sits on
+ * segment i % num_segments, and the n-th participant created reaches
+ * segment n % num_segments.  Every sample is delivered latency_us after it
+ * was published.
+ */
+void dds_loopback_configure(int num_devices,
+                            int num_segments,
+                            unsigned int latency_us);
+
+#endif
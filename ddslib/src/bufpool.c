@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include "bufpool.h"
+
+static int bufpool_owns(const struct bufpool *bufpool, const char *buf)
+{
+    return buf >= bufpool->storage &&
+           buf < bufpool->storage + bufpool->count * bufpool->bufsize;
+}
+
+int bufpool_initialize(struct bufpool *bufpool,
+                       unsigned int count,
+                       size_t bufsize)
+{
+    unsigned int i;
+
+    bufpool->storage = malloc(count * bufsize);
+    bufpool->freelist = malloc(count * sizeof(*bufpool->freelist));
+    if ((count && bufpool->storage == NULL) ||
+        (count && bufpool->freelist == NULL))
+    {
+        free(bufpool->storage);
+        free(bufpool->freelist);
+        return 1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        bufpool->freelist[i] = bufpool->storage + i * bufsize;
+    }
+
+    pthread_mutex_init(&bufpool->mutex, NULL);
+    bufpool->bufsize = bufsize;
+    bufpool->count = count;
+    bufpool->nfree = count;
+
+    return 0;
+}
+
+void bufpool_destroy(struct bufpool *bufpool)
+{
+    pthread_mutex_destroy(&bufpool->mutex);
+    free(bufpool->storage);
+    free(bufpool->freelist);
+    bufpool->storage = NULL;
+    bufpool->freelist = NULL;
+}
+
+void *bufpool_borrow(struct bufpool *bufpool,
+                     size_t size)
+{
+    void *buf;
+
+    buf = NULL;
+
+    if (size <= bufpool->bufsize)
+    {
+        pthread_mutex_lock(&bufpool->mutex);
+        if (bufpool->nfree)
+        {
+            buf = bufpool->freelist[--bufpool->nfree];
+        }
+        pthread_mutex_unlock(&bufpool->mutex);
+    }
+
+    if (buf == NULL)
+    {
+        buf = malloc(size ? size : 1);
+    }
+
+    return buf;
+}
+
+void bufpool_release(struct bufpool *bufpool,
+                     void *buf)
+{
+    if (buf == NULL)
+    {
+        return;
+    }
+
+    if (!bufpool_owns(bufpool, buf))
+    {
+        free(buf);
+        return;
+    }
+
+    pthread_mutex_lock(&bufpool->mutex);
+    bufpool->freelist[bufpool->nfree++] = buf;
+    pthread_mutex_unlock(&bufpool->mutex);
+}
@@ -0,0 +1,31 @@
+#ifndef __BUFPOOL_H__
+#define __BUFPOOL_H__
+
+#include <pthread.h>
+#include <stddef.h>
+
+/*
+ * Fixed set of preallocated, equally sized buffers.  Requests that do not
+ * fit in a pool buffer, or that arrive while every buffer is borrowed, fall
+ * back to the heap; bufpool_release() tells the two apart, so callers never
+ * need to know where a buffer came from.
+ */
+struct bufpool {
+    pthread_mutex_t mutex;
+    size_t bufsize;
+    unsigned int count;
+    unsigned int nfree;
+    char *storage;
+    char **freelist;
+};
+
+int bufpool_initialize(struct bufpool *bufpool,
+                       unsigned int count,
+                       size_t bufsize);
+void bufpool_destroy(struct bufpool *bufpool);
+void *bufpool_borrow(struct bufpool *bufpool,
+                     size_t size);
+void bufpool_release(struct bufpool *bufpool,
+                     void *buf);
+
+#endif
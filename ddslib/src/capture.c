@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include "capture.h"
+#include "epstats.h"
+
+#define CAPTURE_BUFFER_SIZE (64 * 1024)
+
+_Static_assert(sizeof(struct capture_record) == 24,
+               "capture records must not contain padding");
+
+int capture_open(struct capture *capture,
+                 const char *path)
+{
+    capture->file = fopen(path, "wb");
+    if (capture->file == NULL)
+    {
+        return 1;
+    }
+
+    if (fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1, 1,
+               capture->file) != 1)
+    {
+        fclose(capture->file);
+        capture->file = NULL;
+        return 1;
+    }
+
+    setvbuf(capture->file, NULL, _IOFBF, CAPTURE_BUFFER_SIZE);
+    pthread_mutex_init(&capture->mutex, NULL);
+
+    return 0;
+}
+
+void capture_close(struct capture *capture)
+{
+    if (capture->file == NULL)
+    {
+        return;
+    }
+
+    fclose(capture->file);
+    capture->file = NULL;
+    pthread_mutex_destroy(&capture->mutex);
+}
+
+void capture_record(struct capture *capture,
+                    enum capturetype type,
+                    int request_id,
+                    int interface,
+                    const char *name,
+                    const void *data,
+                    unsigned int data_len)
+{
+    struct capture_record record;
+
+    memset(&record, 0, sizeof(record));
+    record.stamp_ns = epstats_now();
+    record.request_id = request_id;
+    record.data_len = data_len < CAPTURE_DATA_MAX ? data_len :
+                                                    CAPTURE_DATA_MAX;
+    record.type = type;
+    record.interface = interface;
+    record.name_len = name != NULL ? strnlen(name, CAPTURE_NAME_MAX) : 0;
+
+    pthread_mutex_lock(&capture->mutex);
+    fwrite(&record, sizeof(record), 1, capture->file);
+    fwrite(name, 1, record.name_len, capture->file);
+    fwrite(data, 1, record.data_len, capture->file);
+    pthread_mutex_unlock(&capture->mutex);
+}
+
+int capture_reader_open(struct capture_reader *reader,
+                        const char *path)
+{
+    char magic[sizeof(CAPTURE_MAGIC) - 1];
+
+    reader->data = NULL;
+    reader->data_size = 0;
+
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL)
+    {
+        return 1;
+    }
+
+    if (fread(magic, sizeof(magic), 1, reader->file) != 1 ||
+        memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0)
+    {
+        fclose(reader->file);
+        reader->file = NULL;
+        return 1;
+    }
+
+    return 0;
+}
+
+void capture_reader_close(struct capture_reader *reader)
+{
+    if (reader->file != NULL)
+    {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+    free(reader->data);
+    reader->data = NULL;
+    reader->data_size = 0;
+}
+
+int capture_read(struct capture_reader *reader,
+                 struct capture_record *record,
+                 char name[CAPTURE_NAME_MAX + 1],
+                 const char **data)
+{
+    char *grown;
+
+    if (fread(record, sizeof(*record), 1, reader->file) != 1 ||
+        record->name_len > CAPTURE_NAME_MAX ||
+        record->data_len > CAPTURE_DATA_MAX)
+    {
+        return 1;
+    }
+
+    if (fread(name, 1, record->name_len, reader->file) != record->name_len)
+    {
+        return 1;
+    }
+    name[record->name_len] = '\0';
+
+    if (record->data_len > reader->data_size)
+    {
+        grown = realloc(reader->data, record->data_len);
+        if (grown == NULL)
+        {
+            return 1;
+        }
+        reader->data = grown;
+        reader->data_size = record->data_len;
+    }
+    if (fread(reader->data, 1, record->data_len, reader->file) !=
+        record->data_len)
+    {
+        return 1;
+    }
+    *data = reader->data;
+
+    return 0;
+}
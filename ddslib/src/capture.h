@@ -0,0 +1,83 @@
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Binary record of the management samples that pass through
+ * ddsmgr.  A capture file starts with the eight byte CAPTURE_MAGIC and is
+ * followed by records, each a struct capture_record in host byte order,
+ * then name_len bytes of device name and data_len bytes of payload.
+ * stamp_ns is CLOCK_MONOTONIC, so only the differences between stamps of
+ * one file mean anything.  Names are cut to CAPTURE_NAME_MAX bytes and
+ * payloads to CAPTURE_DATA_MAX, the largest NMP message an MCmd or MRsp
+ * can carry: an eight byte header and a body of up to 65535 bytes.
+ * interface is the index of the interface a pong arrived on and is zero
+ * for every other record type.
+ *
+ * Records are written through a stdio buffer under a mutex, so recording
+ * costs a memcpy on the hot path; the buffer is flushed when the capture
+ * is closed.  A file that already exists is truncated, so that a capture
+ * never spans two runs and, across a reboot, two monotonic clocks.
+ */
+#define CAPTURE_MAGIC "DDSCAP\0\1"
+#define CAPTURE_NAME_MAX 16
+#define CAPTURE_DATA_MAX (8 + 65535)
+
+enum capturetype {
+    CAPTURETYPE_MCMD = 0,
+    CAPTURETYPE_MRSP = 1,
+    CAPTURETYPE_PING = 2,
+    CAPTURETYPE_PONG = 3,
+};
+
+struct capture_record {
+    uint64_t stamp_ns;
+    int32_t request_id;
+    uint32_t data_len;
+    uint8_t type;
+    uint8_t interface;
+    uint16_t name_len;
+    uint32_t reserved;
+};
+
+struct capture {
+    pthread_mutex_t mutex;
+    FILE *file;
+};
+
+int capture_open(struct capture *capture,
+                 const char *path);
+void capture_close(struct capture *capture);
+void capture_record(struct capture *capture,
+                    enum capturetype type,
+                    int request_id,
+                    int interface,
+                    const char *name,
+                    const void *data,
+                    unsigned int data_len);
+
+/*
+ * Sequential reader of a capture file.  capture_read() returns 0 with the
+ * next record, its name NUL-terminated in name and its payload in a buffer
+ * owned by the reader that stays valid until the next call; it returns 1
+ * at the end of the file or on a truncated or malformed record, including
+ * one whose name or payload is longer than a writer would have recorded.
+ */
+struct capture_reader {
+    FILE *file;
+    char *data;
+    uint32_t data_size;
+};
+
+int capture_reader_open(struct capture_reader *reader,
+                        const char *path);
+void capture_reader_close(struct capture_reader *reader);
+int capture_read(struct capture_reader *reader,
+                 struct capture_record *record,
+                 char name[CAPTURE_NAME_MAX + 1],
+                 const char **data);
+
+#endif
@@ -1,116 +1,184 @@
-#include <netinet/in.h>
-#include <net/if.h>
 #include <assert.h>
-#include <ifaddrs.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-#include "../lib2/dds.h"
+#include "dds.h"
 #include "ddsmgr.h"
+#include "bufpool.h"
+#include "capture.h"
+#include "devregistry.h"
+#include "epstats.h"
+#include "intflist.h"
 #include "matcherwait.h"
-#include "rendezvous.h"
+#include "notify.h"
+#include "pendtable.h"
+#include "pubqueue.h"
+#include "ringqueue.h"
+#include "trace.h"
 
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MRSP_PENDING_BUCKETS 256
+#define DEVICE_REGISTRY_BUCKETS 256
 
-struct ip4ifdesc {
-    uint32_t address;
-    uint32_t netmask;
-};
+_Static_assert(DDSMGR_READY_MCMD == 1 << MATCHERTYPE_MCMD &&
+               DDSMGR_READY_MRSP == 1 << MATCHERTYPE_MRSP &&
+               DDSMGR_READY_PING == 1 << MATCHERTYPE_PING &&
+               DDSMGR_READY_PONG == 1 << MATCHERTYPE_PONG,
+               "ready bits must follow matcher types");
 
-static int valid_ipv4_ifaddr(const struct ifaddrs *ifaddr)
-{
-    return ifaddr->ifa_name != NULL &&
-           ifaddr->ifa_addr != NULL &&
-           ifaddr->ifa_netmask != NULL &&
-           ifaddr->ifa_addr->sa_family == AF_INET &&
-           ifaddr->ifa_flags & IFF_UP;
-}
+struct ddsmgr_ctx {
+    struct matcherwait matchwait;
+    struct bufpool rsp_bufpool;
+    struct pendtable mrsp_pendtable;
+    struct ringqueue pong_ringqueue;
+    struct devregistry device_registry;
+    struct epstats mcmd_stats;
+    struct epstats mrsp_stats;
+    struct epstats ping_stats;
+    struct epstats pong_stats;
+    struct capture capture;
+    struct pubqueue pubqueue;
+    int pubqueue_running;
+    /* Id and monotonic send time of the most recent ping, the time zero
+     * once the id has been sent more than once. */
+    atomic_int ping_request_id;
+    atomic_ullong ping_sent_ns;
+};
 
-static void copy_ipv4_intf(const struct ifaddrs *ifaddr,
-                           struct ip4ifdesc *ifdesc)
-{
-    uint32_t address, netmask;
+/*
+ * Received samples as the receive path sees them.  Live samples refer to
+ * the DDS sample they arrived in; samples replayed from a capture carry
+ * their payload directly, as the DDS sample types cannot be built outside
+ * the DDS library.
+ */
+struct mrsp_sample {
+    int request_id;
+    int rsp_size;
+    const char *rsp_data;
+    PacketMRsp *packet;
+};
 
-    address = ((const struct sockaddr_in *)ifaddr->ifa_addr)->sin_addr.s_addr;
-    netmask = ((const struct sockaddr_in *)ifaddr->ifa_netmask)->sin_addr.s_addr;
-    address = ntohl(address);
-    netmask = ntohl(netmask);
-    ifdesc->address = address;
-    ifdesc->netmask = netmask;
-}
+struct pong_sample {
+    int request_id;
+    const char *device_name;
+};
 
-static const char *external_intf_prefixes[] =
-{
-    "en",
-    "wlo",
-    "",
+/*
+ * The DDS layer hosts its participants per process and its callbacks carry
+ * no reference to a ddsmgr context.  The participants are therefore
+ * created by the first context, one per selected interface, and bound to
+ * at most one context at a time; the callbacks dispatch to whichever
+ * context is bound.  Endpoints that matched before a context was bound are
+ * remembered so that a later context does not wait for matches that will
+ * never be reported again.  An endpoint counts as matched once it matched
+ * on any interface.  A failed creation is not retried over the partly
+ * created participants; it is reported to every later context instead.
+ *
+ * Only a DDS library that provides the DDS_MULTI_PARTICIPANT extension can
+ * host more than one participant; with any other, selecting more than one
+ * interface is an error rather than a silent fallback to the first.
+ */
+struct participant {
+    struct intfdesc intf;
+#ifdef DDS_MULTI_PARTICIPANT
+    dds_participant *dds;
+#endif
 };
 
-static void find_ipv4_intfs(struct ip4ifdesc *ifdesc)
-{
-    struct ifaddrs *ifaddrs, *ifaddr;
-    uint32_t i;
+static pthread_rwlock_t participant_lock = PTHREAD_RWLOCK_INITIALIZER;
+static struct ddsmgr_ctx *participant_ctx;
+static int participant_created;
+static int participant_failed;
+static unsigned int participant_matched;
+static struct participant participants[DDSMGR_MAX_INTERFACES];
+static int participant_count;
 
-    getifaddrs(&ifaddrs);
+static struct ddsmgr_ctx *participant_acquire(void)
+{
+    pthread_rwlock_rdlock(&participant_lock);
+    return participant_ctx;
+}
 
-    ifdesc->address = 0;
-    ifdesc->netmask = 0;
+static void participant_release(void)
+{
+    pthread_rwlock_unlock(&participant_lock);
+}
 
-    for (i = 0; i < sizeof(external_intf_prefixes) /
-                    sizeof(*external_intf_prefixes); i++)
+static void participant_match(enum matchertype matchtype)
+{
+    pthread_rwlock_wrlock(&participant_lock);
+    participant_matched |= 1 << matchtype;
+    if (participant_ctx != NULL)
     {
-        const char *prefixptr;
-        size_t prefixlen;
-
-        prefixptr = external_intf_prefixes[i];
-        prefixlen = strlen(prefixptr);
-
-        for (ifaddr = ifaddrs; ifaddr != NULL; ifaddr = ifaddr->ifa_next)
-        {
-            if (valid_ipv4_ifaddr(ifaddr) &&
-                strncmp(ifaddr->ifa_name, prefixptr, prefixlen) == 0)
-            {
-                copy_ipv4_intf(ifaddr, ifdesc);
-                goto done;
-            }
-        }
+        matcherwait_wake(&participant_ctx->matchwait, matchtype);
     }
-
-done:
-
-    freeifaddrs(ifaddrs);
+    pthread_rwlock_unlock(&participant_lock);
 }
 
-static struct matcherwait init_matchwait;
-static struct rendezvous mrsp_rendezvous;
-static struct rendezvous pong_rendezvous;
-
-static void convert_packet_mrsp(void *dst, void *src)
+static void convert_packet_mrsp(void *arg, void *dst, void *src)
 {
+    struct ddsmgr_ctx *ctx;
     struct packet_mrsp *dstmrsp;
-    PacketMRsp *srcmrsp;
+    struct mrsp_sample *srcmrsp;
 
+    ctx = arg;
     dstmrsp = dst;
     srcmrsp = src;
 
     dstmrsp->request_id = srcmrsp->request_id;
-    dstmrsp->rsp_size = MIN(DDS_CharSeq_get_length(&srcmrsp->rsp_data),
-                            sizeof(dstmrsp->rsp_data));
-    DDS_CharSeq_to_array(&srcmrsp->rsp_data,
-                         (DDS_Char *)dstmrsp->rsp_data,
-                         dstmrsp->rsp_size);
+    dstmrsp->rsp_size = srcmrsp->rsp_size;
+    if (srcmrsp->rsp_size == DDSMGR_MRSP_UNPUBLISHED)
+    {
+        dstmrsp->rsp_data = NULL;
+        return;
+    }
+    dstmrsp->rsp_data = bufpool_borrow(&ctx->rsp_bufpool, dstmrsp->rsp_size);
+    if (dstmrsp->rsp_data == NULL)
+    {
+        epstats_add(&ctx->mrsp_stats.dropped_nobuf, 1);
+        dstmrsp->rsp_size = 0;
+        return;
+    }
+    if (srcmrsp->packet != NULL)
+    {
+        DDS_CharSeq_to_array(&srcmrsp->packet->rsp_data,
+                             (DDS_Char *)dstmrsp->rsp_data,
+                             dstmrsp->rsp_size);
+    }
+    else
+    {
+        memcpy(dstmrsp->rsp_data, srcmrsp->rsp_data, dstmrsp->rsp_size);
+    }
+}
+
+static void discard_packet_mrsp(void *arg, void *data)
+{
+    struct ddsmgr_ctx *ctx;
+    struct packet_mrsp *mrsp;
+
+    ctx = arg;
+    mrsp = data;
+
+    bufpool_release(&ctx->rsp_bufpool, mrsp->rsp_data);
 }
 
 static void convert_packet_pong(void *dst, void *src)
 {
     struct packet_pong *dstpong;
-    PacketPong *srcpong;
+    struct pong_sample *srcpong;
 
     dstpong = dst;
     srcpong = src;
 
     dstpong->request_id = srcpong->request_id;
-    memcpy(dstpong->device_name, srcpong->device_name,
-           sizeof(dstpong->device_name));
+    strncpy(dstpong->device_name, srcpong->device_name,
+            DDSMGR_DEVICE_NAME_LEN);
+    dstpong->device_name[DDSMGR_DEVICE_NAME_LEN] = '\0';
 }
 
 static int print_error(const char *fmt, ...)
@@ -125,47 +193,240 @@ static int print_error(const char *fmt, ...)
     return res;
 }
 
+static void mrsp_deliver(struct ddsmgr_ctx *ctx,
+                         struct mrsp_sample *sample)
+{
+    uint64_t start;
+
+    start = trace_on() ? epstats_now() : 0;
+
+    epstats_add(&ctx->mrsp_stats.samples, 1);
+    epstats_add(&ctx->mrsp_stats.bytes, sample->rsp_size);
+    pendtable_produce(&ctx->mrsp_pendtable, sample->request_id, sample);
+
+    if (start)
+    {
+        trace_record(DDSMGR_TRACE_DELIVER, sample->request_id,
+                     start, epstats_now());
+    }
+}
+
+static void pong_deliver(struct ddsmgr_ctx *ctx,
+                         int interface,
+                         struct pong_sample *sample)
+{
+    epstats_add(&ctx->pong_stats.samples, 1);
+    devregistry_update(&ctx->device_registry, sample->device_name,
+                       sample->request_id, interface,
+                       participants[interface].intf.name);
+    ringqueue_produce(&ctx->pong_ringqueue, sample);
+}
+
+/*
+ * Only live pongs are timed; a replayed one answers a ping this context
+ * never sent.
+ */
+static void pong_rtt_sample(struct ddsmgr_ctx *ctx,
+                            struct pong_sample *sample)
+{
+    uint64_t sent;
+
+    if (sample->request_id != atomic_load(&ctx->ping_request_id))
+    {
+        return;
+    }
+    sent = atomic_load(&ctx->ping_sent_ns);
+    if (sent != 0)
+    {
+        devregistry_rtt_sample(&ctx->device_registry, sample->device_name,
+                               epstats_now() - sent, 0);
+    }
+}
+
+/*
+ * The payload of a live sample can only be copied out of it, so it is
+ * staged in a response buffer for the capture.
+ */
+static void mrsp_capture(struct ddsmgr_ctx *ctx,
+                         struct mrsp_sample *sample)
+{
+    char *data;
+
+    data = bufpool_borrow(&ctx->rsp_bufpool, sample->rsp_size);
+    if (data == NULL)
+    {
+        return;
+    }
+    DDS_CharSeq_to_array(&sample->packet->rsp_data, (DDS_Char *)data,
+                         sample->rsp_size);
+    capture_record(&ctx->capture, CAPTURETYPE_MRSP, sample->request_id, 0,
+                   NULL, data, sample->rsp_size);
+    bufpool_release(&ctx->rsp_bufpool, data);
+}
+
+static void participant_mrsp_received(PacketMRsp *mrsp)
+{
+    struct ddsmgr_ctx *ctx;
+    struct mrsp_sample sample;
+
+    ctx = participant_acquire();
+    if (ctx != NULL)
+    {
+        sample.request_id = mrsp->request_id;
+        sample.rsp_size = DDS_CharSeq_get_length(&mrsp->rsp_data);
+        sample.rsp_data = NULL;
+        sample.packet = mrsp;
+        if (ctx->capture.file != NULL)
+        {
+            mrsp_capture(ctx, &sample);
+        }
+        mrsp_deliver(ctx, &sample);
+    }
+    participant_release();
+}
+
+static void participant_pong_received(struct participant *participant,
+                                      PacketPong *pong)
+{
+    struct ddsmgr_ctx *ctx;
+    struct pong_sample sample;
+    int interface;
+
+    ctx = participant_acquire();
+    if (ctx != NULL)
+    {
+        interface = participant - participants;
+        sample.request_id = pong->request_id;
+        sample.device_name = pong->device_name;
+        if (ctx->capture.file != NULL)
+        {
+            capture_record(&ctx->capture, CAPTURETYPE_PONG,
+                           sample.request_id, interface,
+                           sample.device_name, NULL, 0);
+        }
+        pong_deliver(ctx, interface, &sample);
+        pong_rtt_sample(ctx, &sample);
+    }
+    participant_release();
+}
+
+#ifdef DDS_MULTI_PARTICIPANT
+
+static void mrsp_received(void *arg, PacketMRsp *mrsp)
+{
+    participant_mrsp_received(mrsp);
+}
+
+static void mrsp_submatched(void *arg)
+{
+    participant_match(MATCHERTYPE_MRSP);
+}
+
+static void mcmd_pubmatched(void *arg)
+{
+    participant_match(MATCHERTYPE_MCMD);
+}
+
+static void pong_received(void *arg, PacketPong *pong)
+{
+    participant_pong_received(arg, pong);
+}
+
+static void pong_submatched(void *arg)
+{
+    participant_match(MATCHERTYPE_PONG);
+}
+
+static void ping_pubmatched(void *arg)
+{
+    participant_match(MATCHERTYPE_PING);
+}
+
+static int participant_create_one(struct participant *participant)
+{
+    struct dds_participant_listener listener;
+
+    listener.arg = participant;
+    listener.mrsp_matched = mrsp_submatched;
+    listener.mrsp_received = mrsp_received;
+    listener.pong_matched = pong_submatched;
+    listener.pong_received = pong_received;
+    listener.mcmd_matched = mcmd_pubmatched;
+    listener.ping_matched = ping_pubmatched;
+
+    participant->dds = dds_participant_create(print_error,
+                                              participant->intf.address,
+                                              participant->intf.netmask,
+                                              &listener);
+    if (participant->dds == NULL)
+    {
+        fprintf(stderr, "dds_participant_create failed on %s\n",
+                participant->intf.name);
+        return 1;
+    }
+
+    if (dds_participant_enable(participant->dds))
+    {
+        fprintf(stderr, "dds_participant_enable failed on %s\n",
+                participant->intf.name);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int participant_mcmd_publish(struct participant *participant,
+                                    int request_id,
+                                    const char *device_name,
+                                    const char *cmd_data,
+                                    int cmd_size)
+{
+    return dds_participant_mcmd_publish(participant->dds, request_id,
+                                        device_name, cmd_data, cmd_size);
+}
+
+static int participant_ping_publish(struct participant *participant,
+                                    int request_id)
+{
+    return dds_participant_ping_publish(participant->dds, request_id);
+}
+
+#else
+
 static void mrsp_received(PacketMRsp *mrsp)
 {
-    rendezvous_produce(&mrsp_rendezvous, mrsp);
+    participant_mrsp_received(mrsp);
 }
 
 static void mrsp_submatched(void)
 {
-    matcherwait_wake(&init_matchwait, MATCHERTYPE_MRSP);
+    participant_match(MATCHERTYPE_MRSP);
 }
 
 static void mcmd_pubmatched(void)
 {
-    matcherwait_wake(&init_matchwait, MATCHERTYPE_MCMD);
+    participant_match(MATCHERTYPE_MCMD);
 }
 
 static void pong_received(PacketPong *pong)
 {
-    rendezvous_produce(&pong_rendezvous, pong);
+    participant_pong_received(&participants[0], pong);
 }
 
 static void pong_submatched(void)
 {
-    matcherwait_wake(&init_matchwait, MATCHERTYPE_PONG);
+    participant_match(MATCHERTYPE_PONG);
 }
 
 static void ping_pubmatched(void)
 {
-    matcherwait_wake(&init_matchwait, MATCHERTYPE_PING);
+    participant_match(MATCHERTYPE_PING);
 }
 
-int ddsmgr_initialize(const struct abs_timeout *timo)
+static int participant_create_one(struct participant *participant)
 {
-    struct ip4ifdesc ifdesc;
-
-    find_ipv4_intfs(&ifdesc);
-
-    matcherwait_initialize(&init_matchwait);
-    rendezvous_initialize(&mrsp_rendezvous, convert_packet_mrsp);
-    rendezvous_initialize(&pong_rendezvous, convert_packet_pong);
-
-    if (dds_create(print_error, ifdesc.address, ifdesc.netmask))
+    if (dds_create(print_error, participant->intf.address,
+                   participant->intf.netmask))
     {
         fprintf(stderr, "dds_create failed\n");
         return 1;
@@ -174,6 +435,7 @@ int ddsmgr_initialize(const struct abs_timeout *timo)
     if (dds_mrsp_subscriber(mrsp_submatched, mrsp_received))
     {
         fprintf(stderr, "dds_mrsp_subscriber failed\n");
+        return 1;
     }
 
     if (dds_pong_subscriber(pong_submatched, pong_received))
@@ -200,56 +462,958 @@ int ddsmgr_initialize(const struct abs_timeout *timo)
         return 1;
     }
 
-    if (matcherwait_wait(&init_matchwait, timo))
+    return 0;
+}
+
+static int participant_mcmd_publish(struct participant *participant,
+                                    int request_id,
+                                    const char *device_name,
+                                    const char *cmd_data,
+                                    int cmd_size)
+{
+    return dds_mcmd_publish(request_id, device_name, cmd_data, cmd_size);
+}
+
+static int participant_ping_publish(struct participant *participant,
+                                    int request_id)
+{
+    return dds_ping_publish(request_id);
+}
+
+#endif
+
+static int participant_create(const char *interfaces)
+{
+    struct intfdesc intfs[DDSMGR_MAX_INTERFACES];
+    int count, i;
+
+    count = intflist_select(interfaces, intfs, DDSMGR_MAX_INTERFACES);
+    if (count <= 0)
+    {
+        fprintf(stderr, "no usable interface in \"%s\"\n",
+                interfaces != NULL ? interfaces : "");
+        return 1;
+    }
+
+#ifndef DDS_MULTI_PARTICIPANT
+    if (count > 1)
     {
-        fprintf(stderr, "failed to match dds client\n");
+        fprintf(stderr, "\"%s\" selects %d interfaces but the dds "
+                "library hosts a single participant\n", interfaces, count);
         return 1;
     }
+#endif
+
+    for (i = 0; i < count; i++)
+    {
+        participants[i].intf = intfs[i];
+        if (participant_create_one(&participants[i]))
+        {
+            return 1;
+        }
+        participant_count = i + 1;
+    }
 
     return 0;
 }
 
-void ddsmgr_mcmd_send(const struct packet_mcmd *mcmd)
+/*
+ * Publishes on the interface the device was last seen on, or on every
+ * interface if it has not been seen.  Fails only if every publish failed.
+ */
+static int participant_mcmd_route(struct ddsmgr_ctx *ctx,
+                                  int request_id,
+                                  const char *device_name,
+                                  const char *cmd_data,
+                                  int cmd_size)
+{
+    int index, failed, i;
+
+    if (participant_count > 1)
+    {
+        index = devregistry_interface(&ctx->device_registry, device_name);
+        if (index >= 0 && index < participant_count)
+        {
+            return participant_mcmd_publish(&participants[index],
+                                            request_id, device_name,
+                                            cmd_data, cmd_size);
+        }
+    }
+
+    failed = 0;
+    for (i = 0; i < participant_count; i++)
+    {
+        failed += participant_mcmd_publish(&participants[i], request_id,
+                                           device_name, cmd_data,
+                                           cmd_size) != 0;
+    }
+
+    return failed == participant_count;
+}
+
+static int participant_ping_all(int request_id)
+{
+    int failed, i;
+
+    failed = 0;
+    for (i = 0; i < participant_count; i++)
+    {
+        failed += participant_ping_publish(&participants[i],
+                                           request_id) != 0;
+    }
+
+    return failed == participant_count;
+}
+
+static int participant_bind(struct ddsmgr_ctx *ctx,
+                            const char *interfaces)
+{
+    int result, create, i;
+
+    result = 0;
+    create = 0;
+
+    pthread_rwlock_wrlock(&participant_lock);
+    if (participant_ctx != NULL)
+    {
+        fprintf(stderr, "dds participant already bound to a context\n");
+        result = 1;
+        goto unlock;
+    }
+    if (participant_created && participant_failed)
+    {
+        fprintf(stderr, "dds participant creation failed earlier\n");
+        result = 1;
+        goto unlock;
+    }
+    participant_ctx = ctx;
+    for (i = 0; i < MATCHERTYPE_MAX; i++)
+    {
+        if (participant_matched & (1 << i))
+        {
+            matcherwait_wake(&ctx->matchwait, i);
+        }
+    }
+    create = !participant_created;
+unlock:
+    pthread_rwlock_unlock(&participant_lock);
+
+    if (result || !create)
+    {
+        return result;
+    }
+
+    result = participant_create(interfaces);
+
+    pthread_rwlock_wrlock(&participant_lock);
+    participant_created = 1;
+    participant_failed = result;
+    pthread_rwlock_unlock(&participant_lock);
+
+    return result;
+}
+
+static void participant_unbind(struct ddsmgr_ctx *ctx)
+{
+    pthread_rwlock_wrlock(&participant_lock);
+    if (participant_ctx == ctx)
+    {
+        participant_ctx = NULL;
+    }
+    pthread_rwlock_unlock(&participant_lock);
+}
+
+/*
+ * Runs on the publish queue's writer thread.
+ */
+static int publish_posted(void *arg, const struct pubsample *sample)
+{
+    struct ddsmgr_ctx *ctx;
+    struct packet_ping ping;
+
+    ctx = arg;
+
+    switch (sample->type)
+    {
+    case PUBTYPE_MCMD:
+        epstats_wait(&ctx->mcmd_stats, sample->queued);
+        if (trace_on())
+        {
+            trace_record(DDSMGR_TRACE_QUEUE, sample->request_id,
+                         sample->queued, epstats_now());
+        }
+        if (sample->data == NULL && sample->size > 0)
+        {
+            epstats_add(&ctx->mcmd_stats.errors, 1);
+            return 1;
+        }
+        return ddsmgr_mcmd_publish(ctx, sample->device_name,
+                                   sample->request_id,
+                                   sample->data, sample->size);
+    case PUBTYPE_PING:
+        epstats_wait(&ctx->ping_stats, sample->queued);
+        ping.request_id = sample->request_id;
+        return ddsmgr_ping_send(ctx, &ping);
+    }
+
+    return 1;
+}
+
+void ddsmgr_config_default(struct ddsmgr_config *config)
+{
+    config->queue_depth = DDSMGR_DEFAULT_QUEUE_DEPTH;
+    config->rsp_pool_count = DDSMGR_DEFAULT_RSP_POOL_COUNT;
+    config->rsp_buf_size = DDSMGR_DEFAULT_RSP_BUF_SIZE;
+    config->interfaces = NULL;
+    config->capture_path = NULL;
+    config->pub_queue_depth = DDSMGR_DEFAULT_PUB_QUEUE_DEPTH;
+    config->pub_buf_size = DDSMGR_DEFAULT_PUB_BUF_SIZE;
+}
+
+struct ddsmgr_ctx *ddsmgr_create(const struct ddsmgr_config *config)
 {
-    dds_mcmd_publish(mcmd->request_id,
-                     mcmd->device_name,
-                     mcmd->cmd_data,
-                     mcmd->cmd_size);
+    struct ddsmgr_ctx *ctx;
+
+    ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL)
+    {
+        fprintf(stderr, "failed to allocate ddsmgr context\n");
+        return NULL;
+    }
+
+    matcherwait_initialize(&ctx->matchwait);
+    epstats_initialize(&ctx->mcmd_stats);
+    epstats_initialize(&ctx->mrsp_stats);
+    epstats_initialize(&ctx->ping_stats);
+    epstats_initialize(&ctx->pong_stats);
+    atomic_init(&ctx->ping_request_id, -1);
+    atomic_init(&ctx->ping_sent_ns, 0);
+
+    if (bufpool_initialize(&ctx->rsp_bufpool, config->rsp_pool_count,
+                           config->rsp_buf_size))
+    {
+        fprintf(stderr, "bufpool_initialize failed\n");
+        goto err_bufpool;
+    }
+
+    if (pendtable_initialize(&ctx->mrsp_pendtable, MRSP_PENDING_BUCKETS,
+                             sizeof(struct packet_mrsp),
+                             convert_packet_mrsp,
+                             discard_packet_mrsp,
+                             ctx,
+                             &ctx->mrsp_stats))
+    {
+        fprintf(stderr, "pendtable_initialize failed\n");
+        goto err_pendtable;
+    }
+
+    if (ringqueue_initialize(&ctx->pong_ringqueue, config->queue_depth,
+                             sizeof(struct packet_pong),
+                             convert_packet_pong,
+                             &ctx->pong_stats))
+    {
+        fprintf(stderr, "ringqueue_initialize failed\n");
+        goto err_ringqueue;
+    }
+
+    if (devregistry_initialize(&ctx->device_registry,
+                               DEVICE_REGISTRY_BUCKETS))
+    {
+        fprintf(stderr, "devregistry_initialize failed\n");
+        goto err_devregistry;
+    }
+
+    if (config->capture_path != NULL &&
+        capture_open(&ctx->capture, config->capture_path))
+    {
+        fprintf(stderr, "failed to open capture file %s\n",
+                config->capture_path);
+        goto err_capture;
+    }
+
+    if (participant_bind(ctx, config->interfaces))
+    {
+        goto err_bind;
+    }
+
+    if (config->pub_queue_depth != 0)
+    {
+        if (pubqueue_initialize(&ctx->pubqueue, config->pub_queue_depth,
+                                config->pub_buf_size, publish_posted, ctx))
+        {
+            fprintf(stderr, "pubqueue_initialize failed\n");
+            goto err_bind;
+        }
+        ctx->pubqueue_running = 1;
+    }
+
+    return ctx;
+
+err_bind:
+    participant_unbind(ctx);
+    capture_close(&ctx->capture);
+err_capture:
+    devregistry_destroy(&ctx->device_registry);
+err_devregistry:
+    ringqueue_destroy(&ctx->pong_ringqueue);
+err_ringqueue:
+    pendtable_destroy(&ctx->mrsp_pendtable);
+err_pendtable:
+    bufpool_destroy(&ctx->rsp_bufpool);
+err_bufpool:
+    free(ctx);
+
+    return NULL;
+}
+
+void ddsmgr_destroy(struct ddsmgr_ctx *ctx)
+{
+    if (ctx->pubqueue_running)
+    {
+        pubqueue_destroy(&ctx->pubqueue);
+    }
+    participant_unbind(ctx);
+
+    capture_close(&ctx->capture);
+    devregistry_destroy(&ctx->device_registry);
+    ringqueue_destroy(&ctx->pong_ringqueue);
+    pendtable_destroy(&ctx->mrsp_pendtable);
+    bufpool_destroy(&ctx->rsp_bufpool);
+    free(ctx);
 }
 
-int ddsmgr_mrsp_recv(const struct abs_timeout *timo,
+unsigned int ddsmgr_ready(struct ddsmgr_ctx *ctx)
+{
+    return matcherwait_matched(&ctx->matchwait);
+}
+
+int ddsmgr_wait_ready(struct ddsmgr_ctx *ctx,
+                      unsigned int ready_mask,
+                      const struct abs_timeout *timo)
+{
+    return matcherwait_wait(&ctx->matchwait, ready_mask, timo);
+}
+
+int ddsmgr_mcmd_send(struct ddsmgr_ctx *ctx,
+                     const struct packet_mcmd *mcmd)
+{
+    return ddsmgr_mcmd_publish(ctx,
+                               mcmd->device_name,
+                               mcmd->request_id,
+                               mcmd->cmd_data,
+                               mcmd->cmd_size);
+}
+
+int ddsmgr_mcmd_publish(struct ddsmgr_ctx *ctx,
+                        const char *device_name,
+                        int request_id,
+                        const char *cmd_data,
+                        int cmd_size)
+{
+    uint64_t start;
+
+    start = trace_on() ? epstats_now() : 0;
+
+    if (participant_mcmd_route(ctx, request_id, device_name,
+                               cmd_data, cmd_size))
+    {
+        epstats_add(&ctx->mcmd_stats.errors, 1);
+        return 1;
+    }
+
+    if (start)
+    {
+        trace_record(DDSMGR_TRACE_PUBLISH, request_id,
+                     start, epstats_now());
+    }
+
+    epstats_add(&ctx->mcmd_stats.samples, 1);
+    epstats_add(&ctx->mcmd_stats.bytes, cmd_size);
+    if (ctx->capture.file != NULL)
+    {
+        capture_record(&ctx->capture, CAPTURETYPE_MCMD, request_id, 0,
+                       device_name, cmd_data, cmd_size);
+    }
+
+    return 0;
+}
+
+static int post_sample(struct ddsmgr_ctx *ctx,
+                       struct epstats *epstats,
+                       const struct pubsample *sample,
+                       unsigned long long *token)
+{
+    if (!ctx->pubqueue_running ||
+        pubqueue_post(&ctx->pubqueue, sample, token))
+    {
+        epstats_add(&epstats->dropped_full, 1);
+        return 1;
+    }
+
+    return 0;
+}
+
+int ddsmgr_mcmd_post(struct ddsmgr_ctx *ctx,
+                     const char *device_name,
+                     int request_id,
+                     const char *cmd_data,
+                     int cmd_size,
+                     void (*posted)(void *arg, int request_id, int status),
+                     void *arg,
+                     unsigned long long *token)
+{
+    struct pubsample sample;
+
+    if (cmd_size < 0)
+    {
+        return 1;
+    }
+
+    sample.type = PUBTYPE_MCMD;
+    sample.request_id = request_id;
+    strncpy(sample.device_name, device_name, DDSMGR_DEVICE_NAME_LEN);
+    sample.device_name[DDSMGR_DEVICE_NAME_LEN] = '\0';
+    sample.data = cmd_data;
+    sample.size = cmd_size;
+    sample.posted = posted;
+    sample.arg = arg;
+
+    return post_sample(ctx, &ctx->mcmd_stats, &sample, token);
+}
+
+int ddsmgr_ping_post(struct ddsmgr_ctx *ctx,
+                     const struct packet_ping *ping,
+                     void (*posted)(void *arg, int request_id, int status),
+                     void *arg,
+                     unsigned long long *token)
+{
+    struct pubsample sample;
+
+    sample.type = PUBTYPE_PING;
+    sample.request_id = ping->request_id;
+    sample.device_name[0] = '\0';
+    sample.data = NULL;
+    sample.size = 0;
+    sample.posted = posted;
+    sample.arg = arg;
+
+    return post_sample(ctx, &ctx->ping_stats, &sample, token);
+}
+
+int ddsmgr_post_wait(struct ddsmgr_ctx *ctx,
+                     unsigned long long token,
+                     const struct abs_timeout *timo)
+{
+    if (!ctx->pubqueue_running)
+    {
+        return 1;
+    }
+
+    return pubqueue_wait(&ctx->pubqueue, token, timo);
+}
+
+void ddsmgr_mcmd_posted(void *arg,
+                        int request_id,
+                        int status)
+{
+    struct ddsmgr_ctx *ctx;
+    struct mrsp_sample failed;
+
+    ctx = arg;
+    if (status == 0)
+    {
+        return;
+    }
+
+    failed.request_id = request_id;
+    failed.rsp_size = DDSMGR_MRSP_UNPUBLISHED;
+    failed.rsp_data = NULL;
+    failed.packet = NULL;
+    pendtable_produce(&ctx->mrsp_pendtable, request_id, &failed);
+}
+
+int ddsmgr_mrsp_register(struct ddsmgr_ctx *ctx,
+                         int request_id)
+{
+    struct packet_mrsp mrsp;
+
+    mrsp.request_id = request_id;
+    mrsp.rsp_size = 0;
+    mrsp.rsp_data = NULL;
+
+    switch (pendtable_register(&ctx->mrsp_pendtable, request_id, &mrsp, 1))
+    {
+    case 0:
+        return 0;
+    case PENDTABLE_EXISTS:
+        return DDSMGR_ID_IN_USE;
+    default:
+        return 1;
+    }
+}
+
+int ddsmgr_mrsp_recv(struct ddsmgr_ctx *ctx,
+                     int request_id,
+                     const struct abs_timeout *timo,
                      struct packet_mrsp *mrsp)
 {
-    return rendezvous_consume(&mrsp_rendezvous, mrsp, timo);
+    return pendtable_consume(&ctx->mrsp_pendtable, request_id, mrsp, timo);
+}
+
+void ddsmgr_mrsp_release(struct ddsmgr_ctx *ctx,
+                         struct packet_mrsp *mrsp)
+{
+    bufpool_release(&ctx->rsp_bufpool, mrsp->rsp_data);
+    mrsp->rsp_data = NULL;
+    mrsp->rsp_size = 0;
+}
+
+void ddsmgr_mrsp_unregister(struct ddsmgr_ctx *ctx,
+                            int request_id)
+{
+    pendtable_unregister(&ctx->mrsp_pendtable, request_id);
+}
+
+static int fanout_request_id(int request_id, int index)
+{
+    return (int)(((unsigned int)request_id + index) & INT_MAX);
+}
+
+int ddsmgr_mcmd_fanout(struct ddsmgr_ctx *ctx,
+                       const char *const *device_names,
+                       int count,
+                       int request_id,
+                       const char *cmd_data,
+                       int cmd_size,
+                       const struct abs_timeout *timo,
+                       struct ddsmgr_fanout_result *results)
+{
+    struct packet_mrsp mrsp;
+    int responded, rc, i;
+
+    mrsp.rsp_size = 0;
+    mrsp.rsp_data = NULL;
+
+    /* Registered as not pollable, so that a dispatcher draining the
+     * response fd cannot take the fan-out's responses. */
+    for (i = 0; i < count; i++)
+    {
+        mrsp.request_id = fanout_request_id(request_id, i);
+        results[i].device_name = device_names[i];
+        results[i].status = DDSMGR_FANOUT_TIMEOUT;
+        results[i].mrsp = mrsp;
+        rc = pendtable_register(&ctx->mrsp_pendtable, mrsp.request_id,
+                                &mrsp, 0);
+        if (rc)
+        {
+            while (i-- > 0)
+            {
+                pendtable_unregister(&ctx->mrsp_pendtable,
+                                     results[i].mrsp.request_id);
+            }
+            return rc == PENDTABLE_EXISTS ? DDSMGR_FANOUT_ID_IN_USE :
+                                            DDSMGR_FANOUT_NOMEM;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (ddsmgr_mcmd_publish(ctx, device_names[i],
+                                results[i].mrsp.request_id,
+                                cmd_data, cmd_size))
+        {
+            results[i].status = DDSMGR_FANOUT_SEND_ERROR;
+        }
+    }
+
+    responded = 0;
+    for (i = 0; i < count; i++)
+    {
+        mrsp = results[i].mrsp;
+        if (results[i].status == DDSMGR_FANOUT_TIMEOUT &&
+            pendtable_consume(&ctx->mrsp_pendtable, mrsp.request_id,
+                              &results[i].mrsp, timo) == 0)
+        {
+            if (results[i].mrsp.rsp_data == NULL)
+            {
+                results[i].status = DDSMGR_FANOUT_NOBUF;
+            }
+            else
+            {
+                results[i].status = DDSMGR_FANOUT_OK;
+                responded++;
+            }
+        }
+        pendtable_unregister(&ctx->mrsp_pendtable, mrsp.request_id);
+    }
+
+    return responded;
+}
+
+void ddsmgr_mcmd_fanout_release(struct ddsmgr_ctx *ctx,
+                                struct ddsmgr_fanout_result *results,
+                                int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (results[i].status == DDSMGR_FANOUT_OK)
+        {
+            ddsmgr_mrsp_release(ctx, &results[i].mrsp);
+        }
+    }
+}
+
+int ddsmgr_mrsp_fd(struct ddsmgr_ctx *ctx)
+{
+    return pendtable_fd(&ctx->mrsp_pendtable);
+}
+
+int ddsmgr_mrsp_tryrecv(struct ddsmgr_ctx *ctx,
+                        struct packet_mrsp *mrsp)
+{
+    return pendtable_tryconsume(&ctx->mrsp_pendtable, mrsp);
 }
 
-void ddsmgr_mrsp_listen(void)
+int ddsmgr_pong_fd(struct ddsmgr_ctx *ctx)
 {
-    rendezvous_listen(&mrsp_rendezvous);
+    return ringqueue_fd(&ctx->pong_ringqueue);
 }
 
-void ddsmgr_mrsp_reject(void)
+int ddsmgr_pong_tryrecv(struct ddsmgr_ctx *ctx,
+                        struct packet_pong *pong)
 {
-    rendezvous_reject(&mrsp_rendezvous);
+    return ringqueue_tryconsume(&ctx->pong_ringqueue, pong);
 }
 
-void ddsmgr_ping_send(const struct packet_ping *ping)
+void ddsmgr_notify_clear(int fd)
 {
-    dds_ping_publish(ping->request_id);
+    struct notify notify;
+
+    notify.fd = fd;
+    notify_clear(&notify);
+}
+
+/*
+ * Karn's rule: once a ping id has gone out twice, a pong carrying it could
+ * answer either copy, so it is no longer timed.
+ */
+static void ping_rtt_start(struct ddsmgr_ctx *ctx,
+                           int request_id)
+{
+    atomic_store(&ctx->ping_sent_ns, 0);
+    if (atomic_exchange(&ctx->ping_request_id, request_id) != request_id)
+    {
+        atomic_store(&ctx->ping_sent_ns, epstats_now());
+    }
+}
+
+int ddsmgr_ping_send(struct ddsmgr_ctx *ctx,
+                     const struct packet_ping *ping)
+{
+    ping_rtt_start(ctx, ping->request_id);
+    if (participant_ping_all(ping->request_id))
+    {
+        epstats_add(&ctx->ping_stats.errors, 1);
+        return 1;
+    }
+
+    epstats_add(&ctx->ping_stats.samples, 1);
+    if (ctx->capture.file != NULL)
+    {
+        capture_record(&ctx->capture, CAPTURETYPE_PING, ping->request_id, 0,
+                       NULL, NULL, 0);
+    }
+
+    return 0;
 }
 
-int ddsmgr_pong_recv(const struct abs_timeout *timo,
+int ddsmgr_pong_recv(struct ddsmgr_ctx *ctx,
+                     const struct abs_timeout *timo,
                      struct packet_pong *pong)
 {
-    return rendezvous_consume(&pong_rendezvous, pong, timo);
+    return ringqueue_consume(&ctx->pong_ringqueue, pong, timo);
+}
+
+void ddsmgr_pong_listen(struct ddsmgr_ctx *ctx)
+{
+    ringqueue_listen(&ctx->pong_ringqueue);
+}
+
+void ddsmgr_pong_reject(struct ddsmgr_ctx *ctx)
+{
+    ringqueue_reject(&ctx->pong_ringqueue);
+}
+
+int ddsmgr_discover(struct ddsmgr_ctx *ctx,
+                    const struct packet_ping *ping,
+                    const struct abs_timeout *timo)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = timo->seconds;
+    timeout.tv_nsec = timo->nseconds;
+
+    if (ddsmgr_ping_send(ctx, ping))
+    {
+        return 0;
+    }
+    while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME,
+                           &timeout, NULL) == EINTR)
+    {
+    }
+
+    return devregistry_count_request(&ctx->device_registry,
+                                     ping->request_id);
+}
+
+int ddsmgr_device_lookup(struct ddsmgr_ctx *ctx,
+                         const char *device_name,
+                         struct ddsmgr_device *device)
+{
+    return devregistry_lookup(&ctx->device_registry, device_name, device);
+}
+
+int ddsmgr_device_list(struct ddsmgr_ctx *ctx,
+                       struct ddsmgr_device *devices,
+                       int max_devices)
+{
+    return devregistry_list(&ctx->device_registry, NULL,
+                            devices, max_devices);
+}
+
+int ddsmgr_device_match(struct ddsmgr_ctx *ctx,
+                        const char *pattern,
+                        struct ddsmgr_device *devices,
+                        int max_devices)
+{
+    return devregistry_list(&ctx->device_registry, pattern,
+                            devices, max_devices);
+}
+
+int ddsmgr_device_rtt_sample(struct ddsmgr_ctx *ctx,
+                             const char *device_name,
+                             unsigned long long rtt_ns)
+{
+    return devregistry_rtt_sample(&ctx->device_registry, device_name,
+                                  rtt_ns, 1);
+}
+
+unsigned long long ddsmgr_device_rto(struct ddsmgr_ctx *ctx,
+                                     const char *device_name)
+{
+    struct ddsmgr_device device;
+    unsigned long long rto;
+
+    if (devregistry_lookup(&ctx->device_registry, device_name, &device) ||
+        device.srtt_ns == 0)
+    {
+        return DDSMGR_RTO_INITIAL_NS;
+    }
+
+    rto = device.srtt_ns + 4 * device.rttvar_ns;
+
+    return rto < DDSMGR_RTO_MIN_NS ? DDSMGR_RTO_MIN_NS : rto;
+}
+
+int ddsmgr_trace_start(unsigned int spans_per_thread)
+{
+    return trace_start(spans_per_thread);
+}
+
+void ddsmgr_trace_stop(void)
+{
+    trace_stop();
 }
 
-void ddsmgr_pong_listen(void)
+unsigned long long ddsmgr_trace_now(void)
 {
-    rendezvous_listen(&pong_rendezvous);
+    return trace_on() ? epstats_now() : 0;
 }
 
-void ddsmgr_pong_reject(void)
+void ddsmgr_trace_span(int stage,
+                       int request_id,
+                       unsigned long long start_ns,
+                       unsigned long long end_ns)
 {
-    rendezvous_reject(&pong_rendezvous);
+    trace_record(stage, request_id, start_ns, end_ns);
+}
+
+int ddsmgr_trace_write(const char *path)
+{
+    return trace_write(path);
+}
+
+void ddsmgr_stats(struct ddsmgr_ctx *ctx,
+                  struct ddsmgr_stats *stats)
+{
+    epstats_snapshot(&ctx->mcmd_stats, &stats->mcmd);
+    epstats_snapshot(&ctx->mrsp_stats, &stats->mrsp);
+    epstats_snapshot(&ctx->ping_stats, &stats->ping);
+    epstats_snapshot(&ctx->pong_stats, &stats->pong);
+}
+
+/*
+ * Request ids registered on behalf of replayed MCmds and not yet answered.
+ */
+struct replay_pending {
+    int *ids;
+    int count;
+    int size;
+};
+
+static int replay_pending_add(struct replay_pending *pending,
+                              int request_id)
+{
+    int *grown;
+    int size;
+
+    if (pending->count == pending->size)
+    {
+        size = pending->size ? pending->size * 2 : 64;
+        grown = realloc(pending->ids, size * sizeof(*grown));
+        if (grown == NULL)
+        {
+            return 1;
+        }
+        pending->ids = grown;
+        pending->size = size;
+    }
+    pending->ids[pending->count++] = request_id;
+
+    return 0;
+}
+
+static int replay_pending_remove(struct replay_pending *pending,
+                                 int request_id)
+{
+    int i;
+
+    for (i = pending->count - 1; i >= 0; i--)
+    {
+        if (pending->ids[i] == request_id)
+        {
+            pending->ids[i] = pending->ids[--pending->count];
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void replay_pace(uint64_t start, uint64_t offset, double speed)
+{
+    struct timespec due;
+    uint64_t ns;
+
+    if (speed <= 0)
+    {
+        return;
+    }
+
+    ns = start + (uint64_t)(offset / speed);
+    due.tv_sec = ns / 1000000000ull;
+    due.tv_nsec = ns % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                           &due, NULL) == EINTR)
+    {
+    }
+}
+
+int ddsmgr_replay(struct ddsmgr_ctx *ctx,
+                  const char *path,
+                  double speed)
+{
+    struct capture_reader reader;
+    struct capture_record record;
+    struct replay_pending pending;
+    struct mrsp_sample mrsp;
+    struct pong_sample pong;
+    struct packet_mrsp registered, claimed;
+    struct abs_timeout expired;
+    uint64_t prev, offset, start;
+    char name[CAPTURE_NAME_MAX + 1];
+    const char *data;
+    int records, replayed, i;
+
+    if (capture_reader_open(&reader, path))
+    {
+        fprintf(stderr, "failed to open capture file %s\n", path);
+        return -1;
+    }
+
+    memset(&pending, 0, sizeof(pending));
+    expired.seconds = 0;
+    expired.nseconds = 0;
+    registered.rsp_size = 0;
+    registered.rsp_data = NULL;
+    records = 0;
+    replayed = 0;
+    prev = 0;
+    offset = 0;
+    start = epstats_now();
+
+    while (capture_read(&reader, &record, name, &data) == 0)
+    {
+        /* A stamp that goes backwards is replayed without delay. */
+        if (records++ > 0 && record.stamp_ns > prev)
+        {
+            offset += record.stamp_ns - prev;
+        }
+        prev = record.stamp_ns;
+        replay_pace(start, offset, speed);
+
+        switch (record.type)
+        {
+        case CAPTURETYPE_MCMD:
+            /* Not pollable: the replay claims these responses itself. */
+            registered.request_id = record.request_id;
+            if (pendtable_register(&ctx->mrsp_pendtable, record.request_id,
+                                   &registered, 0) == 0 &&
+                replay_pending_add(&pending, record.request_id))
+            {
+                ddsmgr_mrsp_unregister(ctx, record.request_id);
+            }
+            break;
+        case CAPTURETYPE_MRSP:
+            mrsp.request_id = record.request_id;
+            mrsp.rsp_size = record.data_len;
+            mrsp.rsp_data = data;
+            mrsp.packet = NULL;
+            mrsp_deliver(ctx, &mrsp);
+            if (replay_pending_remove(&pending, record.request_id) == 0)
+            {
+                if (pendtable_consume(&ctx->mrsp_pendtable,
+                                      record.request_id, &claimed,
+                                      &expired) == 0)
+                {
+                    ddsmgr_mrsp_release(ctx, &claimed);
+                }
+                ddsmgr_mrsp_unregister(ctx, record.request_id);
+            }
+            replayed++;
+            break;
+        case CAPTURETYPE_PONG:
+            pong.request_id = record.request_id;
+            pong.device_name = name;
+            pong_deliver(ctx,
+                         record.interface < participant_count ?
+                         record.interface : 0,
+                         &pong);
+            replayed++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (i = 0; i < pending.count; i++)
+    {
+        ddsmgr_mrsp_unregister(ctx, pending.ids[i]);
+    }
+    free(pending.ids);
+    capture_reader_close(&reader);
+
+    return replayed;
 }
@@ -1,6 +1,10 @@
 #ifndef __DDSMGR_H__
 #define __DDSMGR_H__
 
+#define DDSMGR_DEVICE_NAME_LEN 16
+#define DDSMGR_INTERFACE_NAME_LEN 16
+#define DDSMGR_MAX_INTERFACES 8
+
 struct abs_timeout {
     unsigned long seconds;
     long nseconds;
@@ -13,10 +17,15 @@ struct packet_mcmd {
     int cmd_size;
 };
 
+/*
+ * rsp_data points to a buffer borrowed from the ddsmgr response pool and
+ * holds the complete response of rsp_size bytes.  It stays valid until the
+ * packet is handed back with ddsmgr_mrsp_release().
+ */
 struct packet_mrsp {
     int request_id;
     int rsp_size;
-    char rsp_data[1024];
+    char *rsp_data;
 };
 
 struct packet_ping {
@@ -25,23 +34,387 @@ struct packet_ping {
 
 struct packet_pong {
     int request_id;
-    char device_name[16];
+    char device_name[DDSMGR_DEVICE_NAME_LEN + 1];
 };
 
-int ddsmgr_initialize(const struct abs_timeout *timo);
+/*
+ * Registry entry for a device that answered a ping.  request_id is the id
+ * of the last ping it answered, last_seen is the wall-clock time the pong
+ * arrived and interface_name is the interface it arrived on.  srtt_ns and
+ * rttvar_ns are the device's smoothed round-trip time and its variation,
+ * both zero until the first round trip has been measured.
+ */
+struct ddsmgr_device {
+    char device_name[DDSMGR_DEVICE_NAME_LEN + 1];
+    int request_id;
+    struct abs_timeout last_seen;
+    char interface_name[DDSMGR_INTERFACE_NAME_LEN];
+    unsigned long long srtt_ns;
+    unsigned long long rttvar_ns;
+};
+
+#define DDSMGR_DEFAULT_QUEUE_DEPTH     64
+#define DDSMGR_DEFAULT_RSP_POOL_COUNT  32
+#define DDSMGR_DEFAULT_RSP_BUF_SIZE    2048
+#define DDSMGR_DEFAULT_PUB_QUEUE_DEPTH 64
+#define DDSMGR_DEFAULT_PUB_BUF_SIZE    512
+
+#define DDSMGR_RTO_INITIAL_NS          1000000000ULL
+#define DDSMGR_RTO_MIN_NS              1000000000ULL
+
+struct ddsmgr_config {
+    /* Number of preallocated slots in each receive queue. */
+    unsigned int queue_depth;
+    /* Number and size of preallocated response buffers.  Larger responses,
+     * or responses arriving while the pool is empty, use the heap. */
+    unsigned int rsp_pool_count;
+    unsigned int rsp_buf_size;
+    /* Number of slots in the asynchronous publish queue, zero to run
+     * without a writer thread, and the payload size a slot holds without
+     * a heap allocation. */
+    unsigned int pub_queue_depth;
+    unsigned int pub_buf_size;
+    /* Interfaces to bind: NULL picks one external interface, "*" binds
+     * every up non-loopback interface, otherwise a comma-separated list of
+     * interface names.  More than one interface needs a DDS library with
+     * the DDS_MULTI_PARTICIPANT extension; without it creation fails.
+     * Only read by the context that creates the DDS participants, i.e. the
+     * first one. */
+    const char *interfaces;
+    /* File to write a capture of all management traffic to, or NULL. */
+    const char *capture_path;
+};
+
+/*
+ * Opaque handle owning the DDS readers, writers, queues and registry used
+ * by every other ddsmgr call.
+ */
+struct ddsmgr_ctx;
+
+void ddsmgr_config_default(struct ddsmgr_config *config);
 
-void ddsmgr_mcmd_send(const struct packet_mcmd *mcmd);
+struct ddsmgr_ctx *ddsmgr_create(const struct ddsmgr_config *config);
+void ddsmgr_destroy(struct ddsmgr_ctx *ctx);
 
-int ddsmgr_mrsp_recv(const struct abs_timeout *timo,
+/*
+ * Endpoints match independently and in no particular order.  Callers wait
+ * only for the endpoints they are about to use: discovery needs
+ * DDSMGR_READY_DISCOVERY, commands need DDSMGR_READY_COMMAND.
+ */
+#define DDSMGR_READY_MCMD      (1 << 0)
+#define DDSMGR_READY_MRSP      (1 << 1)
+#define DDSMGR_READY_PING      (1 << 2)
+#define DDSMGR_READY_PONG      (1 << 3)
+#define DDSMGR_READY_COMMAND   (DDSMGR_READY_MCMD | DDSMGR_READY_MRSP)
+#define DDSMGR_READY_DISCOVERY (DDSMGR_READY_PING | DDSMGR_READY_PONG)
+#define DDSMGR_READY_ALL       (DDSMGR_READY_COMMAND | DDSMGR_READY_DISCOVERY)
+
+unsigned int ddsmgr_ready(struct ddsmgr_ctx *ctx);
+int ddsmgr_wait_ready(struct ddsmgr_ctx *ctx,
+                      unsigned int ready_mask,
+                      const struct abs_timeout *timo);
+
+int ddsmgr_mcmd_send(struct ddsmgr_ctx *ctx,
+                     const struct packet_mcmd *mcmd);
+
+/*
+ * Publishes an MCmd straight from caller-owned memory.  Neither buffer is
+ * retained after the call returns, so device_name may be a handle the
+ * caller keeps for the lifetime of its transport and cmd_data may point
+ * into memory the caller only pins for the duration of the call.
+ *
+ * With several interfaces bound, the MCmd goes out only on the interface
+ * the device's last pong arrived on, or on every interface if the device
+ * has not been seen yet.
+ */
+int ddsmgr_mcmd_publish(struct ddsmgr_ctx *ctx,
+                        const char *device_name,
+                        int request_id,
+                        const char *cmd_data,
+                        int cmd_size);
+
+/*
+ * Asynchronous publishing.  ddsmgr_mcmd_post() and ddsmgr_ping_post() copy
+ * the sample into a lock-free queue and return at once; a writer thread
+ * publishes queued samples in order, back to back.  They return 1 without
+ * queuing if the queue is full or there is no writer thread.  Otherwise
+ * *token, unless token is NULL, identifies the sample for
+ * ddsmgr_post_wait(), and posted, unless NULL, is called on the writer
+ * thread with arg, the request id and the publish result (0 on success)
+ * once the sample has gone out.  posted must not block.
+ *
+ * ddsmgr_post_wait() returns 0 once the sample a token was issued for,
+ * and every sample posted before it, has been published, or 1 on timeout.
+ */
+int ddsmgr_mcmd_post(struct ddsmgr_ctx *ctx,
+                     const char *device_name,
+                     int request_id,
+                     const char *cmd_data,
+                     int cmd_size,
+                     void (*posted)(void *arg, int request_id, int status),
+                     void *arg,
+                     unsigned long long *token);
+int ddsmgr_ping_post(struct ddsmgr_ctx *ctx,
+                     const struct packet_ping *ping,
+                     void (*posted)(void *arg, int request_id, int status),
+                     void *arg,
+                     unsigned long long *token);
+int ddsmgr_post_wait(struct ddsmgr_ctx *ctx,
+                     unsigned long long token,
+                     const struct abs_timeout *timo);
+
+/*
+ * posted callback, with the context as arg, for MCmds whose response is
+ * awaited.  If such an MCmd cannot be published, its registered request
+ * completes at once with rsp_size DDSMGR_MRSP_UNPUBLISHED and no data,
+ * rather than waiting out its timeout for a response that cannot come.
+ */
+#define DDSMGR_MRSP_UNPUBLISHED (-1)
+
+void ddsmgr_mcmd_posted(void *arg,
+                        int request_id,
+                        int status);
+
+/*
+ * Any number of MCmds may be outstanding at once.  A response is routed
+ * to its waiter by request id, so the id must be registered before the
+ * MCmd is sent and unregistered once the caller is done with it.
+ * ddsmgr_mrsp_register() returns DDSMGR_ID_IN_USE if the id is already
+ * registered, so the caller can pick another, and 1 if it could not
+ * allocate the registration.  An id
+ * may be unregistered while another thread waits on it in
+ * ddsmgr_mrsp_recv(); that wait then fails at once.
+ */
+#define DDSMGR_ID_IN_USE 2
+
+int ddsmgr_mrsp_register(struct ddsmgr_ctx *ctx,
+                         int request_id);
+int ddsmgr_mrsp_recv(struct ddsmgr_ctx *ctx,
+                     int request_id,
+                     const struct abs_timeout *timo,
                      struct packet_mrsp *mrsp);
-void ddsmgr_mrsp_listen(void);
-void ddsmgr_mrsp_reject(void);
+void ddsmgr_mrsp_release(struct ddsmgr_ctx *ctx,
+                         struct packet_mrsp *mrsp);
+void ddsmgr_mrsp_unregister(struct ddsmgr_ctx *ctx,
+                            int request_id);
+
+/*
+ * Sends the same MCmd to each of count devices and collects their MRsps
+ * against a single deadline.  Every MCmd is published before the first
+ * response is awaited, so the call takes one round trip, not count.
+ * Device i is sent request id request_id + i (wrapping within the
+ * non-negative ints); if any of those ids is already registered nothing is
+ * sent and DDSMGR_FANOUT_ID_IN_USE is returned, and the caller retries
+ * with another id.  If registering fails for any other reason nothing is
+ * sent and DDSMGR_FANOUT_NOMEM is returned.  Otherwise returns the number
+ * of devices whose result is DDSMGR_FANOUT_OK.
+ *
+ * results must hold count entries.  Each is filled in whatever the
+ * outcome; the responses of DDSMGR_FANOUT_OK entries are borrowed from
+ * the response pool and handed back with ddsmgr_mcmd_fanout_release().
+ * The fan-out's responses are never returned by ddsmgr_mrsp_tryrecv().
+ */
+#define DDSMGR_FANOUT_ID_IN_USE  (-1)
+#define DDSMGR_FANOUT_NOMEM      (-2)
 
-void ddsmgr_ping_send(const struct packet_ping *ping);
+#define DDSMGR_FANOUT_OK         0
+#define DDSMGR_FANOUT_TIMEOUT    1
+#define DDSMGR_FANOUT_SEND_ERROR 2
+#define DDSMGR_FANOUT_NOBUF      3
 
-int ddsmgr_pong_recv(const struct abs_timeout *timo,
+struct ddsmgr_fanout_result {
+    const char *device_name;
+    int status;
+    struct packet_mrsp mrsp;
+};
+
+int ddsmgr_mcmd_fanout(struct ddsmgr_ctx *ctx,
+                       const char *const *device_names,
+                       int count,
+                       int request_id,
+                       const char *cmd_data,
+                       int cmd_size,
+                       const struct abs_timeout *timo,
+                       struct ddsmgr_fanout_result *results);
+void ddsmgr_mcmd_fanout_release(struct ddsmgr_ctx *ctx,
+                                struct ddsmgr_fanout_result *results,
+                                int count);
+
+/*
+ * Poll-based receive.  The fd becomes readable when a response or pong is
+ * queued; the consumer clears it, either with ddsmgr_notify_clear() or by
+ * reading eight bytes from it, and then calls the matching tryrecv function
+ * until it returns nonzero.  The tryrecv
+ * functions never block.  ddsmgr_mrsp_tryrecv() returns the response of
+ * any registered request, in arrival order; check mrsp->request_id.
+ */
+int ddsmgr_mrsp_fd(struct ddsmgr_ctx *ctx);
+int ddsmgr_mrsp_tryrecv(struct ddsmgr_ctx *ctx,
+                        struct packet_mrsp *mrsp);
+int ddsmgr_pong_fd(struct ddsmgr_ctx *ctx);
+int ddsmgr_pong_tryrecv(struct ddsmgr_ctx *ctx,
+                        struct packet_pong *pong);
+void ddsmgr_notify_clear(int fd);
+
+int ddsmgr_ping_send(struct ddsmgr_ctx *ctx,
+                     const struct packet_ping *ping);
+
+int ddsmgr_pong_recv(struct ddsmgr_ctx *ctx,
+                     const struct abs_timeout *timo,
                      struct packet_pong *pong);
-void ddsmgr_pong_listen(void);
-void ddsmgr_pong_reject(void);
+void ddsmgr_pong_listen(struct ddsmgr_ctx *ctx);
+void ddsmgr_pong_reject(struct ddsmgr_ctx *ctx);
+
+/*
+ * Every pong received, whether or not anyone is listening for pongs, is
+ * recorded in the device registry.  ddsmgr_discover() sends the ping and
+ * collects pongs until the deadline, returning the number of devices that
+ * answered it.
+ */
+int ddsmgr_discover(struct ddsmgr_ctx *ctx,
+                    const struct packet_ping *ping,
+                    const struct abs_timeout *timo);
+int ddsmgr_device_lookup(struct ddsmgr_ctx *ctx,
+                         const char *device_name,
+                         struct ddsmgr_device *device);
+int ddsmgr_device_list(struct ddsmgr_ctx *ctx,
+                       struct ddsmgr_device *devices,
+                       int max_devices);
+
+/*
+ * Like ddsmgr_device_list(), but only for devices whose name matches the
+ * shell wildcard pattern, e.g. "sensor-*".  Returns the number of matching
+ * devices, which may exceed max_devices.
+ */
+int ddsmgr_device_match(struct ddsmgr_ctx *ctx,
+                        const char *pattern,
+                        struct ddsmgr_device *devices,
+                        int max_devices);
+
+/*
+ * Round-trip estimation.  Each device keeps a smoothed round-trip time and
+ * variation, updated as RFC 6298 updates TCP's.  Callers add samples for
+ * the command exchanges they time themselves with
+ * ddsmgr_device_rtt_sample().  Until the first of those, a pong answering
+ * the most recent ping is a sample, unless that ping was sent more than
+ * once; pings are answered faster than most commands, so they only seed
+ * the estimate.  A sample should only come from a request that was sent
+ * once, since a response to a retransmitted request cannot be matched to
+ * the copy it answers.
+ *
+ * ddsmgr_device_rto() returns the time to wait for a response before
+ * sending the request again: srtt + 4 * rttvar, at least
+ * DDSMGR_RTO_MIN_NS (RFC 6298's one second), or DDSMGR_RTO_INITIAL_NS for
+ * a device with no samples.  A retransmission reuses the request id, and
+ * the responses it draws beyond the first are dropped as duplicates.
+ */
+int ddsmgr_device_rtt_sample(struct ddsmgr_ctx *ctx,
+                             const char *device_name,
+                             unsigned long long rtt_ns);
+unsigned long long ddsmgr_device_rto(struct ddsmgr_ctx *ctx,
+                                     const char *device_name);
+
+/*
+ * Offline load generation.  With ddsmgr_config.capture_path set, every
+ * MCmd and ping sent and every MRsp and pong received is written, with a
+ * monotonic timestamp, to that file, replacing what it held before.
+ * ddsmgr_replay() feeds a capture's MRsps and pongs back through the
+ * receive path of ctx, paced at speed times the recorded rate, or as fast
+ * as possible if speed is 0.  MCmds and pings are not sent again: an MCmd
+ * record only registers its request id, so that the replayed response
+ * travels the whole receive path before the replay claims and releases it.
+ * Returns the number of samples fed in, or -1 if the file is not a
+ * capture.
+ */
+int ddsmgr_replay(struct ddsmgr_ctx *ctx,
+                  const char *path,
+                  double speed);
+
+/*
+ * Per-request latency tracing.  While a trace is running, ddsmgr records
+ * how long each request spends in each of its stages, and callers add
+ * spans for the stages they own with ddsmgr_trace_span(), taking their
+ * timestamps from ddsmgr_trace_now() so that every span shares one clock.
+ * Stages, in the order a request passes through them:
+ *
+ *   request  the caller's whole request (caller)
+ *   send     the caller handing the MCmd to ddsmgr (caller)
+ *   queue    a posted MCmd waiting for the writer thread
+ *   publish  the DDS write of the MCmd
+ *   deliver  the MRsp moving from the DDS callback into its request's
+ *            slot, the copy into a response buffer included
+ *   wakeup   the delivered MRsp waiting for a consumer to take it
+ *   handoff  the consumer passing the MRsp on to the requester (caller)
+ *   respond  the requester processing the MRsp (caller)
+ *
+ * The time between publish and deliver is the network and the device.
+ *
+ * Tracing is process-wide, since the DDS callback threads are.  Spans go
+ * to a buffer of spans_per_thread entries per thread, without locks; a
+ * thread whose buffer is full drops its spans.  ddsmgr_trace_write()
+ * writes the spans of the last trace started as Chrome trace-event JSON,
+ * one track per request, and returns the number of spans written or -1;
+ * it should be called after ddsmgr_trace_stop().  While no trace is
+ * running, ddsmgr_trace_now() returns 0, ddsmgr_trace_span() does nothing
+ * and tracing costs ddsmgr one relaxed load per stage.
+ */
+#define DDSMGR_TRACE_REQUEST 0
+#define DDSMGR_TRACE_SEND    1
+#define DDSMGR_TRACE_QUEUE   2
+#define DDSMGR_TRACE_PUBLISH 3
+#define DDSMGR_TRACE_DELIVER 4
+#define DDSMGR_TRACE_WAKEUP  5
+#define DDSMGR_TRACE_HANDOFF 6
+#define DDSMGR_TRACE_RESPOND 7
+#define DDSMGR_TRACE_STAGES  8
+
+int ddsmgr_trace_start(unsigned int spans_per_thread);
+void ddsmgr_trace_stop(void);
+unsigned long long ddsmgr_trace_now(void);
+void ddsmgr_trace_span(int stage,
+                       int request_id,
+                       unsigned long long start_ns,
+                       unsigned long long end_ns);
+int ddsmgr_trace_write(const char *path);
+
+/*
+ * Per-endpoint counters.  Writers (mcmd, ping) count samples published,
+ * payload bytes and publish errors.  Readers (mrsp, pong) count samples
+ * received, samples converted into a queue slot, every reason a sample was
+ * dropped, receive timeouts, and the longest time a converted sample
+ * waited before a consumer took it.  dropped_unknown counts responses no
+ * registered request took; dropped_nobuf counts responses whose payload
+ * was lost for want of a buffer; dropped_duplicate counts further
+ * responses to a request that already had one, as a retransmitted MCmd
+ * may draw.  For writers, dropped_full counts posts
+ * refused because the publish queue was full and peak_wait_ns is the
+ * longest a posted sample waited for the writer thread.
+ */
+struct ddsmgr_endpoint_stats {
+    unsigned long long samples;
+    unsigned long long converted;
+    unsigned long long bytes;
+    unsigned long long dropped_disabled;
+    unsigned long long dropped_full;
+    unsigned long long dropped_unknown;
+    unsigned long long dropped_nobuf;
+    unsigned long long dropped_duplicate;
+    unsigned long long errors;
+    unsigned long long timeouts;
+    unsigned long long peak_wait_ns;
+};
+
+struct ddsmgr_stats {
+    struct ddsmgr_endpoint_stats mcmd;
+    struct ddsmgr_endpoint_stats mrsp;
+    struct ddsmgr_endpoint_stats ping;
+    struct ddsmgr_endpoint_stats pong;
+};
+
+/*
+ * Takes no lock; safe to call at any rate from any thread.
+ */
+void ddsmgr_stats(struct ddsmgr_ctx *ctx,
+                  struct ddsmgr_stats *stats);
 
 #endif
@@ -0,0 +1,289 @@
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "devregistry.h"
+
+static unsigned int devregistry_hash(const char *device_name)
+{
+    unsigned int hash;
+    int i;
+
+    hash = 2166136261u;
+    for (i = 0; i < DDSMGR_DEVICE_NAME_LEN && device_name[i]; i++)
+    {
+        hash ^= (unsigned char)device_name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static struct devregentry *devregistry_find(struct devregistry *devregistry,
+                                            const char *device_name,
+                                            unsigned int hash)
+{
+    struct devregentry *entry;
+
+    for (entry = devregistry->buckets[hash % devregistry->nbuckets];
+         entry != NULL;
+         entry = entry->next)
+    {
+        if (strncmp(entry->device.device_name, device_name,
+                    DDSMGR_DEVICE_NAME_LEN) == 0)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+int devregistry_initialize(struct devregistry *devregistry,
+                           unsigned int nbuckets)
+{
+    if (nbuckets == 0)
+    {
+        return 1;
+    }
+
+    devregistry->buckets = calloc(nbuckets, sizeof(*devregistry->buckets));
+    if (devregistry->buckets == NULL)
+    {
+        return 1;
+    }
+
+    pthread_mutex_init(&devregistry->mutex, NULL);
+    devregistry->nbuckets = nbuckets;
+    devregistry->count = 0;
+
+    return 0;
+}
+
+void devregistry_destroy(struct devregistry *devregistry)
+{
+    struct devregentry *entry, *next;
+    unsigned int i;
+
+    for (i = 0; i < devregistry->nbuckets; i++)
+    {
+        for (entry = devregistry->buckets[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            free(entry);
+        }
+    }
+
+    pthread_mutex_destroy(&devregistry->mutex);
+    free(devregistry->buckets);
+    devregistry->buckets = NULL;
+}
+
+int devregistry_update(struct devregistry *devregistry,
+                       const char *device_name,
+                       int request_id,
+                       int interface,
+                       const char *interface_name)
+{
+    struct devregentry *entry;
+    struct timespec now;
+    unsigned int hash;
+    int result;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    hash = devregistry_hash(device_name);
+    result = 0;
+
+    pthread_mutex_lock(&devregistry->mutex);
+    entry = devregistry_find(devregistry, device_name, hash);
+    if (entry == NULL)
+    {
+        entry = calloc(1, sizeof(*entry));
+        if (entry == NULL)
+        {
+            result = 1;
+            goto unlock;
+        }
+        strncpy(entry->device.device_name, device_name,
+                DDSMGR_DEVICE_NAME_LEN);
+        entry->next = devregistry->buckets[hash % devregistry->nbuckets];
+        devregistry->buckets[hash % devregistry->nbuckets] = entry;
+        devregistry->count++;
+    }
+    entry->interface = interface;
+    entry->device.request_id = request_id;
+    entry->device.last_seen.seconds = now.tv_sec;
+    entry->device.last_seen.nseconds = now.tv_nsec;
+    strncpy(entry->device.interface_name, interface_name,
+            DDSMGR_INTERFACE_NAME_LEN - 1);
+unlock:
+    pthread_mutex_unlock(&devregistry->mutex);
+
+    return result;
+}
+
+int devregistry_lookup(struct devregistry *devregistry,
+                       const char *device_name,
+                       struct ddsmgr_device *device)
+{
+    struct devregentry *entry;
+    int result;
+
+    result = 0;
+
+    pthread_mutex_lock(&devregistry->mutex);
+    entry = devregistry_find(devregistry, device_name,
+                             devregistry_hash(device_name));
+    if (entry == NULL)
+    {
+        result = 1;
+        goto unlock;
+    }
+    *device = entry->device;
+unlock:
+    pthread_mutex_unlock(&devregistry->mutex);
+
+    return result;
+}
+
+/*
+ * Returns the interface index the device was last seen on, or -1 if it has
+ * never been seen.
+ */
+int devregistry_interface(struct devregistry *devregistry,
+                          const char *device_name)
+{
+    struct devregentry *entry;
+    int interface;
+
+    pthread_mutex_lock(&devregistry->mutex);
+    entry = devregistry_find(devregistry, device_name,
+                             devregistry_hash(device_name));
+    interface = entry != NULL ? entry->interface : -1;
+    pthread_mutex_unlock(&devregistry->mutex);
+
+    return interface;
+}
+
+/*
+ * Copies out the devices whose name matches the shell wildcard pattern, or
+ * every device if pattern is NULL.  Returns the number of matching devices,
+ * which may exceed max_devices.
+ */
+int devregistry_list(struct devregistry *devregistry,
+                     const char *pattern,
+                     struct ddsmgr_device *devices,
+                     int max_devices)
+{
+    struct devregentry *entry;
+    unsigned int i;
+    int count;
+
+    count = 0;
+
+    pthread_mutex_lock(&devregistry->mutex);
+    for (i = 0; i < devregistry->nbuckets; i++)
+    {
+        for (entry = devregistry->buckets[i]; entry != NULL;
+             entry = entry->next)
+        {
+            if (pattern != NULL &&
+                fnmatch(pattern, entry->device.device_name, 0) != 0)
+            {
+                continue;
+            }
+            if (count < max_devices)
+            {
+                devices[count] = entry->device;
+            }
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&devregistry->mutex);
+
+    return count;
+}
+
+/*
+ * Folds one round-trip time into the device's estimate the way RFC 6298
+ * does: the first sample sets srtt to it and rttvar to half of it, later
+ * samples move rttvar by a quarter and srtt by an eighth of the way
+ * towards them.  Devices answer pings faster than most commands, so the
+ * first command sample starts the estimate afresh and ping samples are
+ * ignored after it.  Returns 1 if the device has never been seen.
+ */
+int devregistry_rtt_sample(struct devregistry *devregistry,
+                           const char *device_name,
+                           uint64_t rtt_ns,
+                           int command)
+{
+    struct ddsmgr_device *device;
+    struct devregentry *entry;
+    uint64_t delta;
+    int result;
+
+    result = 0;
+    if (rtt_ns == 0)
+    {
+        rtt_ns = 1;
+    }
+
+    pthread_mutex_lock(&devregistry->mutex);
+    entry = devregistry_find(devregistry, device_name,
+                             devregistry_hash(device_name));
+    if (entry == NULL)
+    {
+        result = 1;
+        goto unlock;
+    }
+    device = &entry->device;
+    if (entry->commanded && !command)
+    {
+        goto unlock;
+    }
+    if (command && !entry->commanded)
+    {
+        entry->commanded = 1;
+        device->srtt_ns = 0;
+    }
+    if (device->srtt_ns == 0)
+    {
+        device->srtt_ns = rtt_ns;
+        device->rttvar_ns = rtt_ns / 2;
+        goto unlock;
+    }
+    delta = device->srtt_ns > rtt_ns ? device->srtt_ns - rtt_ns
+                                     : rtt_ns - device->srtt_ns;
+    device->rttvar_ns = device->rttvar_ns - device->rttvar_ns / 4 + delta / 4;
+    device->srtt_ns = device->srtt_ns - device->srtt_ns / 8 + rtt_ns / 8;
+unlock:
+    pthread_mutex_unlock(&devregistry->mutex);
+
+    return result;
+}
+
+int devregistry_count_request(struct devregistry *devregistry,
+                              int request_id)
+{
+    struct devregentry *entry;
+    unsigned int i;
+    int count;
+
+    count = 0;
+
+    pthread_mutex_lock(&devregistry->mutex);
+    for (i = 0; i < devregistry->nbuckets; i++)
+    {
+        for (entry = devregistry->buckets[i]; entry != NULL;
+             entry = entry->next)
+        {
+            if (entry->device.request_id == request_id)
+            {
+                count++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&devregistry->mutex);
+
+    return count;
+}
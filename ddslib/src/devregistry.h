@@ -0,0 +1,55 @@
+#ifndef __DEVREGISTRY_H__
+#define __DEVREGISTRY_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include "ddsmgr.h"
+
+/*
+ * Table of every device that has answered a ping, keyed by device name.
+ * Entries are never removed; a device that stops answering simply keeps
+ * its old last_seen time.  Each entry also remembers the index of the
+ * interface its last pong arrived on, so that commands to the device can
+ * be routed there, and the device's round-trip estimate.  commanded is
+ * set once a command exchange has been timed; from then on only commands
+ * update the estimate.
+ */
+struct devregentry {
+    struct devregentry *next;
+    int interface;
+    int commanded;
+    struct ddsmgr_device device;
+};
+
+struct devregistry {
+    pthread_mutex_t mutex;
+    unsigned int nbuckets;
+    unsigned int count;
+    struct devregentry **buckets;
+};
+
+int devregistry_initialize(struct devregistry *devregistry,
+                           unsigned int nbuckets);
+void devregistry_destroy(struct devregistry *devregistry);
+int devregistry_update(struct devregistry *devregistry,
+                       const char *device_name,
+                       int request_id,
+                       int interface,
+                       const char *interface_name);
+int devregistry_lookup(struct devregistry *devregistry,
+                       const char *device_name,
+                       struct ddsmgr_device *device);
+int devregistry_interface(struct devregistry *devregistry,
+                          const char *device_name);
+int devregistry_list(struct devregistry *devregistry,
+                     const char *pattern,
+                     struct ddsmgr_device *devices,
+                     int max_devices);
+int devregistry_rtt_sample(struct devregistry *devregistry,
+                           const char *device_name,
+                           uint64_t rtt_ns,
+                           int command);
+int devregistry_count_request(struct devregistry *devregistry,
+                              int request_id);
+
+#endif
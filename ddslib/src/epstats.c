@@ -0,0 +1,70 @@
+#include <time.h>
+#include "epstats.h"
+
+static unsigned long long epstats_load(atomic_ullong *counter)
+{
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void epstats_initialize(struct epstats *epstats)
+{
+    atomic_init(&epstats->samples, 0);
+    atomic_init(&epstats->converted, 0);
+    atomic_init(&epstats->bytes, 0);
+    atomic_init(&epstats->dropped_disabled, 0);
+    atomic_init(&epstats->dropped_full, 0);
+    atomic_init(&epstats->dropped_unknown, 0);
+    atomic_init(&epstats->dropped_nobuf, 0);
+    atomic_init(&epstats->dropped_duplicate, 0);
+    atomic_init(&epstats->errors, 0);
+    atomic_init(&epstats->timeouts, 0);
+    atomic_init(&epstats->peak_wait_ns, 0);
+}
+
+void epstats_snapshot(struct epstats *epstats,
+                      struct ddsmgr_endpoint_stats *snapshot)
+{
+    snapshot->samples = epstats_load(&epstats->samples);
+    snapshot->converted = epstats_load(&epstats->converted);
+    snapshot->bytes = epstats_load(&epstats->bytes);
+    snapshot->dropped_disabled = epstats_load(&epstats->dropped_disabled);
+    snapshot->dropped_full = epstats_load(&epstats->dropped_full);
+    snapshot->dropped_unknown = epstats_load(&epstats->dropped_unknown);
+    snapshot->dropped_nobuf = epstats_load(&epstats->dropped_nobuf);
+    snapshot->dropped_duplicate = epstats_load(&epstats->dropped_duplicate);
+    snapshot->errors = epstats_load(&epstats->errors);
+    snapshot->timeouts = epstats_load(&epstats->timeouts);
+    snapshot->peak_wait_ns = epstats_load(&epstats->peak_wait_ns);
+}
+
+uint64_t epstats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * Records how long a sample produced at 'since' sat queued before it was
+ * consumed, keeping only the largest value seen.
+ */
+void epstats_wait(struct epstats *epstats,
+                  uint64_t since)
+{
+    unsigned long long waited, peak;
+
+    waited = epstats_now() - since;
+    peak = epstats_load(&epstats->peak_wait_ns);
+    while (waited > peak)
+    {
+        if (atomic_compare_exchange_weak_explicit(&epstats->peak_wait_ns,
+                                                  &peak, waited,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        {
+            break;
+        }
+    }
+}
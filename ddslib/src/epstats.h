@@ -0,0 +1,41 @@
+#ifndef __EPSTATS_H__
+#define __EPSTATS_H__
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "ddsmgr.h"
+
+/*
+ * Counters for one DDS endpoint.  Every field is updated with relaxed
+ * atomics from whichever thread sees the event, so counting never takes a
+ * lock on the hot path; a snapshot is consistent per counter but not
+ * across counters.
+ */
+struct epstats {
+    atomic_ullong samples;
+    atomic_ullong converted;
+    atomic_ullong bytes;
+    atomic_ullong dropped_disabled;
+    atomic_ullong dropped_full;
+    atomic_ullong dropped_unknown;
+    atomic_ullong dropped_nobuf;
+    atomic_ullong dropped_duplicate;
+    atomic_ullong errors;
+    atomic_ullong timeouts;
+    atomic_ullong peak_wait_ns;
+};
+
+void epstats_initialize(struct epstats *epstats);
+void epstats_snapshot(struct epstats *epstats,
+                      struct ddsmgr_endpoint_stats *snapshot);
+uint64_t epstats_now(void);
+void epstats_wait(struct epstats *epstats,
+                  uint64_t since);
+
+static inline void epstats_add(atomic_ullong *counter,
+                               unsigned long long value)
+{
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,116 @@
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "futexwait.h"
+
+#define FUTEXWAIT_SPIN_MIN 16
+#define FUTEXWAIT_SPIN_MAX 4096
+
+static pthread_once_t futexwait_once = PTHREAD_ONCE_INIT;
+static int futexwait_multicore;
+
+static void futexwait_probe(void)
+{
+    futexwait_multicore = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+}
+
+static inline void futexwait_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static int futexwait_park(struct futexwait *futexwait,
+                          unsigned int seq,
+                          const struct abs_timeout *abstimo)
+{
+    struct timespec timeout;
+    long rc;
+
+    if (abstimo != NULL)
+    {
+        timeout.tv_sec = abstimo->seconds;
+        timeout.tv_nsec = abstimo->nseconds;
+    }
+
+    rc = syscall(SYS_futex, (unsigned int *)&futexwait->seq,
+                 FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME,
+                 seq, abstimo != NULL ? &timeout : NULL, NULL,
+                 FUTEX_BITSET_MATCH_ANY);
+
+    return rc != 0 && errno == ETIMEDOUT;
+}
+
+void futexwait_initialize(struct futexwait *futexwait)
+{
+    pthread_once(&futexwait_once, futexwait_probe);
+
+    atomic_init(&futexwait->seq, 0);
+    atomic_init(&futexwait->parked, 0);
+    atomic_init(&futexwait->spin, futexwait_multicore ?
+                                  FUTEXWAIT_SPIN_MIN * 4 : 0);
+}
+
+unsigned int futexwait_prepare(struct futexwait *futexwait)
+{
+    return atomic_load(&futexwait->seq);
+}
+
+/*
+ * Returns once the counter has moved past seq, on a spurious wakeup, or
+ * with 1 once the absolute realtime deadline has passed.  A NULL abstimo
+ * waits without a deadline.  Callers re-check their condition on 0.
+ */
+int futexwait_wait(struct futexwait *futexwait,
+                   unsigned int seq,
+                   const struct abs_timeout *abstimo)
+{
+    unsigned int spin, i;
+    int result;
+
+    spin = atomic_load_explicit(&futexwait->spin, memory_order_relaxed);
+    for (i = 0; i < spin; i++)
+    {
+        if (atomic_load_explicit(&futexwait->seq,
+                                 memory_order_acquire) != seq)
+        {
+            if (spin < FUTEXWAIT_SPIN_MAX)
+            {
+                atomic_store_explicit(&futexwait->spin, spin * 2,
+                                      memory_order_relaxed);
+            }
+            return 0;
+        }
+        futexwait_relax();
+    }
+
+    if (spin > FUTEXWAIT_SPIN_MIN)
+    {
+        atomic_store_explicit(&futexwait->spin, spin / 2,
+                              memory_order_relaxed);
+    }
+
+    atomic_fetch_add(&futexwait->parked, 1);
+    result = futexwait_park(futexwait, seq, abstimo);
+    atomic_fetch_sub(&futexwait->parked, 1);
+
+    return result;
+}
+
+void futexwait_wake(struct futexwait *futexwait)
+{
+    atomic_fetch_add(&futexwait->seq, 1);
+
+    if (atomic_load(&futexwait->parked) != 0)
+    {
+        syscall(SYS_futex, (unsigned int *)&futexwait->seq,
+                FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
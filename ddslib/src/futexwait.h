@@ -0,0 +1,32 @@
+#ifndef __FUTEXWAIT_H__
+#define __FUTEXWAIT_H__
+
+#include <stdatomic.h>
+#include "ddsmgr.h"
+
+/*
+ * Event counter that waiters first spin on and then park on with a futex.
+ * A waiter reads the counter with futexwait_prepare(), checks its own
+ * condition, and only if the condition does not hold calls futexwait_wait()
+ * with the value it read; any futexwait_wake() after the prepare makes the
+ * wait return, so a wakeup between the check and the wait is never lost.
+ * Wakers that find nobody parked never enter the kernel.
+ *
+ * The spin is bounded and adapts per counter: it lengthens while spinning
+ * keeps catching wakeups and shortens while waiters end up parking anyway.
+ * On a single CPU there is no spin at all.
+ */
+struct futexwait {
+    atomic_uint seq;
+    atomic_uint parked;
+    atomic_uint spin;
+};
+
+void futexwait_initialize(struct futexwait *futexwait);
+unsigned int futexwait_prepare(struct futexwait *futexwait);
+int futexwait_wait(struct futexwait *futexwait,
+                   unsigned int seq,
+                   const struct abs_timeout *abstimo);
+void futexwait_wake(struct futexwait *futexwait);
+
+#endif
@@ -0,0 +1,211 @@
+#include <netinet/in.h>
+#include <net/if.h>
+#include <ifaddrs.h>
+#include <stdio.h>
+#include <string.h>
+#include "intflist.h"
+
+static int valid_ipv4_ifaddr(const struct ifaddrs *ifaddr)
+{
+    return ifaddr->ifa_name != NULL &&
+           ifaddr->ifa_addr != NULL &&
+           ifaddr->ifa_netmask != NULL &&
+           ifaddr->ifa_addr->sa_family == AF_INET &&
+           ifaddr->ifa_flags & IFF_UP;
+}
+
+static void copy_ipv4_intf(const struct ifaddrs *ifaddr,
+                           struct intfdesc *intf)
+{
+    const struct sockaddr_in *addr, *mask;
+
+    addr = (const struct sockaddr_in *)ifaddr->ifa_addr;
+    mask = (const struct sockaddr_in *)ifaddr->ifa_netmask;
+
+    strncpy(intf->name, ifaddr->ifa_name, sizeof(intf->name) - 1);
+    intf->name[sizeof(intf->name) - 1] = '\0';
+    intf->address = ntohl(addr->sin_addr.s_addr);
+    intf->netmask = ntohl(mask->sin_addr.s_addr);
+}
+
+static int intflist_contains(const struct intfdesc *intfs,
+                             int count,
+                             const char *name)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (strncmp(intfs[i].name, name, sizeof(intfs[i].name)) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static const char *external_intf_prefixes[] =
+{
+    "en",
+    "wlo",
+    "",
+};
+
+static int select_default(struct ifaddrs *ifaddrs,
+                          struct intfdesc *intf)
+{
+    struct ifaddrs *ifaddr;
+    uint32_t i;
+
+    memset(intf, 0, sizeof(*intf));
+
+    for (i = 0; i < sizeof(external_intf_prefixes) /
+                    sizeof(*external_intf_prefixes); i++)
+    {
+        const char *prefixptr;
+        size_t prefixlen;
+
+        prefixptr = external_intf_prefixes[i];
+        prefixlen = strlen(prefixptr);
+
+        for (ifaddr = ifaddrs; ifaddr != NULL; ifaddr = ifaddr->ifa_next)
+        {
+            if (valid_ipv4_ifaddr(ifaddr) &&
+                strncmp(ifaddr->ifa_name, prefixptr, prefixlen) == 0)
+            {
+                copy_ipv4_intf(ifaddr, intf);
+                return 1;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static int select_all(struct ifaddrs *ifaddrs,
+                      struct intfdesc *intfs,
+                      int max_intfs)
+{
+    struct ifaddrs *ifaddr;
+    int count;
+
+    count = 0;
+
+    for (ifaddr = ifaddrs;
+         ifaddr != NULL && count < max_intfs;
+         ifaddr = ifaddr->ifa_next)
+    {
+        /* An interface with several addresses is bound on its first. */
+        if (valid_ipv4_ifaddr(ifaddr) &&
+            !(ifaddr->ifa_flags & IFF_LOOPBACK) &&
+            !intflist_contains(intfs, count, ifaddr->ifa_name))
+        {
+            copy_ipv4_intf(ifaddr, &intfs[count++]);
+        }
+    }
+
+    return count;
+}
+
+static int select_named(struct ifaddrs *ifaddrs,
+                        const char *spec,
+                        struct intfdesc *intfs,
+                        int max_intfs)
+{
+    struct ifaddrs *ifaddr;
+    const char *name, *end;
+    size_t namelen;
+    int count, i;
+
+    count = 0;
+
+    for (name = spec; *name != '\0'; name = *end ? end + 1 : end)
+    {
+        end = strchr(name, ',');
+        if (end == NULL)
+        {
+            end = name + strlen(name);
+        }
+        namelen = end - name;
+        if (namelen == 0)
+        {
+            continue;
+        }
+
+        if (count == max_intfs)
+        {
+            fprintf(stderr, "too many interfaces in \"%s\"\n", spec);
+            return -1;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            if (strlen(intfs[i].name) == namelen &&
+                strncmp(intfs[i].name, name, namelen) == 0)
+            {
+                fprintf(stderr, "interface %.*s is listed twice\n",
+                        (int)namelen, name);
+                return -1;
+            }
+        }
+
+        for (ifaddr = ifaddrs; ifaddr != NULL; ifaddr = ifaddr->ifa_next)
+        {
+            if (valid_ipv4_ifaddr(ifaddr) &&
+                strlen(ifaddr->ifa_name) == namelen &&
+                strncmp(ifaddr->ifa_name, name, namelen) == 0)
+            {
+                break;
+            }
+        }
+        if (ifaddr == NULL)
+        {
+            fprintf(stderr, "interface %.*s is not up or has no IPv4 "
+                    "address\n", (int)namelen, name);
+            return -1;
+        }
+
+        copy_ipv4_intf(ifaddr, &intfs[count++]);
+    }
+
+    return count;
+}
+
+int intflist_select(const char *spec,
+                    struct intfdesc *intfs,
+                    int max_intfs)
+{
+    struct ifaddrs *ifaddrs;
+    int count;
+
+    if (max_intfs <= 0)
+    {
+        return 0;
+    }
+
+    if (getifaddrs(&ifaddrs) != 0)
+    {
+        ifaddrs = NULL;
+    }
+
+    if (spec == NULL || *spec == '\0')
+    {
+        count = select_default(ifaddrs, intfs);
+    }
+    else if (strcmp(spec, "*") == 0)
+    {
+        count = select_all(ifaddrs, intfs, max_intfs);
+    }
+    else
+    {
+        count = select_named(ifaddrs, spec, intfs, max_intfs);
+    }
+
+    if (ifaddrs != NULL)
+    {
+        freeifaddrs(ifaddrs);
+    }
+
+    return count;
+}
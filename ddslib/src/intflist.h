@@ -0,0 +1,28 @@
+#ifndef __INTFLIST_H__
+#define __INTFLIST_H__
+
+#include <stdint.h>
+#include "ddsmgr.h"
+
+struct intfdesc {
+    char name[DDSMGR_INTERFACE_NAME_LEN];
+    uint32_t address;
+    uint32_t netmask;
+};
+
+/*
+ * Selects the IPv4 interfaces a participant is bound to.  spec is one of:
+ *   NULL or ""  the first up interface whose name starts with "en", then
+ *               "wlo", then any other; always yields one entry, which is
+ *               all zeros if no interface is up.
+ *   "*"         every up, non-loopback interface.
+ *   "a,b,..."   the named interfaces, in the order given; each must be up,
+ *               have an IPv4 address and be named only once.
+ * Returns the number of entries written to intfs, or -1 if a named
+ * interface cannot be used or is repeated.
+ */
+int intflist_select(const char *spec,
+                    struct intfdesc *intfs,
+                    int max_intfs);
+
+#endif
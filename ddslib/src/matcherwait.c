@@ -2,51 +2,38 @@
 
 void matcherwait_initialize(struct matcherwait *matcherwait)
 {
-    pthread_mutex_init(&matcherwait->mutex, NULL);
-    pthread_cond_init(&matcherwait->condvar, NULL);
-    matcherwait->remain = (1 << MATCHERTYPE_MAX) - 1;
+    futexwait_initialize(&matcherwait->futexwait);
+    atomic_init(&matcherwait->matched, 0);
+}
+
+unsigned int matcherwait_matched(struct matcherwait *matcherwait)
+{
+    return atomic_load(&matcherwait->matched);
 }
 
 int matcherwait_wait(struct matcherwait *matcherwait,
+                     unsigned int waitmask,
                      const struct abs_timeout *abstimo)
 {
-    struct timespec timeout;
-    int result;
+    unsigned int seq;
 
-    timeout.tv_sec = abstimo->seconds;
-    timeout.tv_nsec = abstimo->nseconds;
-    result = 0;
-
-    pthread_mutex_lock(&matcherwait->mutex);
-    while (matcherwait->remain)
+    for (;;)
     {
-        if (pthread_cond_timedwait(&matcherwait->condvar,
-                                   &matcherwait->mutex,
-                                   &timeout) != 0)
+        seq = futexwait_prepare(&matcherwait->futexwait);
+        if ((atomic_load(&matcherwait->matched) & waitmask) == waitmask)
+        {
+            return 0;
+        }
+        if (futexwait_wait(&matcherwait->futexwait, seq, abstimo))
         {
-            result = 1;
-            break;
+            return 1;
         }
     }
-    pthread_mutex_unlock(&matcherwait->mutex);
-
-    return result;
 }
 
 void matcherwait_wake(struct matcherwait *matcherwait,
                       enum matchertype waketype)
 {
-    unsigned int clmask, remain;
-
-    clmask = ~(1 << waketype);
-
-    pthread_mutex_lock(&matcherwait->mutex);
-    matcherwait->remain &= clmask;
-    remain = matcherwait->remain;
-    pthread_mutex_unlock(&matcherwait->mutex);
-
-    if (!remain)
-    {
-        pthread_cond_signal(&matcherwait->condvar);
-    }
+    atomic_fetch_or(&matcherwait->matched, 1u << waketype);
+    futexwait_wake(&matcherwait->futexwait);
 }
@@ -1,8 +1,9 @@
 #ifndef __MATCHERWAIT_H__
 #define __MATCHERWAIT_H__
 
-#include <pthread.h>
+#include <stdatomic.h>
 #include "ddsmgr.h"
+#include "futexwait.h"
 
 enum matchertype {
     MATCHERTYPE_MCMD = 0,
@@ -12,14 +13,22 @@ enum matchertype {
     MATCHERTYPE_MAX  = 4,
 };
 
+/*
+ * Tracks which endpoints have matched.  Waiters name the subset of
+ * endpoints they need, so each can proceed as soon as its own subset is
+ * ready rather than waiting for every endpoint.  The mask is a single
+ * atomic word, so neither readers nor wakers take a lock, and there is
+ * nothing to destroy.
+ */
 struct matcherwait {
-    pthread_mutex_t mutex;
-    pthread_cond_t condvar;
-    unsigned int remain;
+    struct futexwait futexwait;
+    atomic_uint matched;
 };
 
 void matcherwait_initialize(struct matcherwait *matcherwait);
+unsigned int matcherwait_matched(struct matcherwait *matcherwait);
 int matcherwait_wait(struct matcherwait *matcherwait,
+                     unsigned int waitmask,
                      const struct abs_timeout *abstimo);
 void matcherwait_wake(struct matcherwait *matcherwait,
                       enum matchertype waketype);
@@ -0,0 +1,41 @@
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "notify.h"
+
+int notify_initialize(struct notify *notify)
+{
+    notify->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    return notify->fd < 0;
+}
+
+void notify_destroy(struct notify *notify)
+{
+    if (notify->fd >= 0)
+    {
+        close(notify->fd);
+        notify->fd = -1;
+    }
+}
+
+void notify_signal(struct notify *notify)
+{
+    uint64_t one;
+
+    one = 1;
+    if (write(notify->fd, &one, sizeof(one)) != sizeof(one))
+    {
+        /* The counter is saturated, which already makes the fd readable. */
+    }
+}
+
+void notify_clear(struct notify *notify)
+{
+    uint64_t count;
+
+    if (read(notify->fd, &count, sizeof(count)) != sizeof(count))
+    {
+        /* Nothing was pending. */
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef __NOTIFY_H__
+#define __NOTIFY_H__
+
+/*
+ * Readable file descriptor that producers poke when a queue goes from
+ * empty to non-empty.  Consumers poll it, drain it with notify_clear(), and
+ * then empty the queue with its non-blocking receive call; a wakeup may
+ * therefore be spurious but is never lost.
+ */
+struct notify {
+    int fd;
+};
+
+int notify_initialize(struct notify *notify);
+void notify_destroy(struct notify *notify);
+void notify_signal(struct notify *notify);
+void notify_clear(struct notify *notify);
+
+#endif
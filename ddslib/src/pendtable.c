@@ -0,0 +1,384 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pendtable.h"
+#include "trace.h"
+
+static struct pendentry **pendtable_bucket(struct pendtable *pendtable,
+                                           int request_id)
+{
+    return &pendtable->buckets[(unsigned int)request_id %
+                               pendtable->nbuckets];
+}
+
+static void pendtable_free(struct pendtable *pendtable,
+                           struct pendentry *entry)
+{
+    if (entry->complete && !entry->claimed)
+    {
+        epstats_add(&pendtable->epstats->dropped_unknown, 1);
+        if (pendtable->discard != NULL)
+        {
+            pendtable->discard(pendtable->cbarg, entry->data);
+        }
+    }
+    free(entry);
+}
+
+static void pendtable_ready_push(struct pendtable *pendtable,
+                                 struct pendentry *entry)
+{
+    int wasempty;
+
+    wasempty = pendtable->readyhead == NULL;
+
+    entry->readynext = NULL;
+    entry->readyprev = pendtable->readytail;
+    *pendtable->readytail = entry;
+    pendtable->readytail = &entry->readynext;
+
+    if (wasempty)
+    {
+        notify_signal(&pendtable->notify);
+    }
+}
+
+static void pendtable_ready_remove(struct pendtable *pendtable,
+                                   struct pendentry *entry)
+{
+    if (entry->readyprev == NULL)
+    {
+        return;
+    }
+
+    *entry->readyprev = entry->readynext;
+    if (entry->readynext != NULL)
+    {
+        entry->readynext->readyprev = entry->readyprev;
+    }
+    else
+    {
+        pendtable->readytail = entry->readyprev;
+    }
+    entry->readynext = NULL;
+    entry->readyprev = NULL;
+}
+
+static void pendtable_claim(struct pendtable *pendtable,
+                            struct pendentry *entry,
+                            void *dstdata)
+{
+    memcpy(dstdata, entry->data, pendtable->slotsize);
+    entry->claimed = 1;
+    pendtable_ready_remove(pendtable, entry);
+    epstats_wait(pendtable->epstats, entry->produced);
+    if (trace_on())
+    {
+        trace_record(DDSMGR_TRACE_WAKEUP, entry->request_id,
+                     entry->produced, epstats_now());
+    }
+}
+
+static struct pendentry *pendtable_find(struct pendtable *pendtable,
+                                        int request_id)
+{
+    struct pendentry *entry;
+
+    for (entry = *pendtable_bucket(pendtable, request_id);
+         entry != NULL;
+         entry = entry->next)
+    {
+        if (entry->request_id == request_id)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+int pendtable_initialize(struct pendtable *pendtable,
+                         unsigned int nbuckets,
+                         size_t slotsize,
+                         void (*convert)(void *arg, void *dst, void *src),
+                         void (*discard)(void *arg, void *data),
+                         void *cbarg,
+                         struct epstats *epstats)
+{
+    if (nbuckets == 0)
+    {
+        return 1;
+    }
+
+    pendtable->buckets = calloc(nbuckets, sizeof(*pendtable->buckets));
+    if (pendtable->buckets == NULL)
+    {
+        return 1;
+    }
+
+    if (notify_initialize(&pendtable->notify))
+    {
+        free(pendtable->buckets);
+        return 1;
+    }
+
+    pthread_mutex_init(&pendtable->mutex, NULL);
+    pendtable->nbuckets = nbuckets;
+    pendtable->readyhead = NULL;
+    pendtable->readytail = &pendtable->readyhead;
+    pendtable->slotsize = slotsize;
+    pendtable->convert = convert;
+    pendtable->discard = discard;
+    pendtable->cbarg = cbarg;
+    pendtable->epstats = epstats;
+
+    return 0;
+}
+
+void pendtable_destroy(struct pendtable *pendtable)
+{
+    struct pendentry *entry, *next;
+    unsigned int i;
+
+    for (i = 0; i < pendtable->nbuckets; i++)
+    {
+        for (entry = pendtable->buckets[i]; entry != NULL; entry = next)
+        {
+            next = entry->next;
+            pendtable_free(pendtable, entry);
+        }
+    }
+
+    notify_destroy(&pendtable->notify);
+    pthread_mutex_destroy(&pendtable->mutex);
+    free(pendtable->buckets);
+    pendtable->buckets = NULL;
+}
+
+int pendtable_register(struct pendtable *pendtable,
+                       int request_id,
+                       const void *initdata,
+                       int pollable)
+{
+    struct pendentry *entry, **bucket;
+    int result;
+
+    entry = malloc(sizeof(*entry) + pendtable->slotsize);
+    if (entry == NULL)
+    {
+        return 1;
+    }
+
+    futexwait_initialize(&entry->futexwait);
+    entry->request_id = request_id;
+    entry->refs = 1;
+    entry->unlinked = 0;
+    entry->producing = 0;
+    entry->complete = 0;
+    entry->claimed = 0;
+    entry->pollable = pollable;
+    entry->readynext = NULL;
+    entry->readyprev = NULL;
+    memcpy(entry->data, initdata, pendtable->slotsize);
+    result = 0;
+
+    pthread_mutex_lock(&pendtable->mutex);
+    if (pendtable_find(pendtable, request_id))
+    {
+        result = PENDTABLE_EXISTS;
+        goto unlock;
+    }
+    bucket = pendtable_bucket(pendtable, request_id);
+    entry->next = *bucket;
+    *bucket = entry;
+    entry = NULL;
+unlock:
+    pthread_mutex_unlock(&pendtable->mutex);
+
+    free(entry);
+
+    return result;
+}
+
+void pendtable_unregister(struct pendtable *pendtable,
+                          int request_id)
+{
+    struct pendentry *entry, **link;
+    int last;
+
+    entry = NULL;
+    last = 0;
+
+    pthread_mutex_lock(&pendtable->mutex);
+    for (link = pendtable_bucket(pendtable, request_id);
+         *link != NULL;
+         link = &(*link)->next)
+    {
+        if ((*link)->request_id == request_id)
+        {
+            entry = *link;
+            *link = entry->next;
+            pendtable_ready_remove(pendtable, entry);
+            /* A consumer parked on the entry keeps it alive until it
+             * wakes and sees it gone. */
+            entry->unlinked = 1;
+            futexwait_wake(&entry->futexwait);
+            last = --entry->refs == 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pendtable->mutex);
+
+    if (last)
+    {
+        pendtable_free(pendtable, entry);
+    }
+}
+
+int pendtable_consume(struct pendtable *pendtable,
+                      int request_id,
+                      void *dstdata,
+                      const struct abs_timeout *abstimo)
+{
+    struct pendentry *entry;
+    unsigned int seq;
+    int result, timedout, last;
+
+    result = 0;
+    timedout = 0;
+    last = 0;
+
+    pthread_mutex_lock(&pendtable->mutex);
+    entry = pendtable_find(pendtable, request_id);
+    if (entry == NULL || entry->claimed)
+    {
+        result = 1;
+        goto unlock;
+    }
+    entry->refs++;
+    while (!entry->complete && !entry->unlinked)
+    {
+        seq = futexwait_prepare(&entry->futexwait);
+        pthread_mutex_unlock(&pendtable->mutex);
+        timedout = futexwait_wait(&entry->futexwait, seq, abstimo);
+        pthread_mutex_lock(&pendtable->mutex);
+        if (timedout)
+        {
+            epstats_add(&pendtable->epstats->timeouts, 1);
+            break;
+        }
+    }
+    if (timedout || entry->unlinked || entry->claimed)
+    {
+        result = 1;
+    }
+    else
+    {
+        pendtable_claim(pendtable, entry, dstdata);
+    }
+    last = --entry->refs == 0;
+unlock:
+    pthread_mutex_unlock(&pendtable->mutex);
+
+    if (last)
+    {
+        pendtable_free(pendtable, entry);
+    }
+
+    return result;
+}
+
+/*
+ * Claims the right to fill in the entry for request_id, taking a reference
+ * on it.  Nothing reads the slot until it is complete, so the caller can
+ * fill it in without the lock.
+ */
+static struct pendentry *pendtable_reserve(struct pendtable *pendtable,
+                                           int request_id)
+{
+    struct pendentry *entry;
+
+    pthread_mutex_lock(&pendtable->mutex);
+    entry = pendtable_find(pendtable, request_id);
+    if (entry == NULL)
+    {
+        epstats_add(&pendtable->epstats->dropped_unknown, 1);
+        goto unlock;
+    }
+    if (entry->producing || entry->complete)
+    {
+        epstats_add(&pendtable->epstats->dropped_duplicate, 1);
+        entry = NULL;
+        goto unlock;
+    }
+    entry->producing = 1;
+    entry->refs++;
+unlock:
+    pthread_mutex_unlock(&pendtable->mutex);
+
+    return entry;
+}
+
+int pendtable_produce(struct pendtable *pendtable,
+                      int request_id,
+                      void *srcdata)
+{
+    struct pendentry *entry;
+    int last;
+
+    entry = pendtable_reserve(pendtable, request_id);
+    if (entry == NULL)
+    {
+        return 1;
+    }
+
+    pendtable->convert(pendtable->cbarg, entry->data, srcdata);
+
+    pthread_mutex_lock(&pendtable->mutex);
+    entry->produced = epstats_now();
+    entry->complete = 1;
+    epstats_add(&pendtable->epstats->converted, 1);
+    if (!entry->unlinked)
+    {
+        if (entry->pollable)
+        {
+            pendtable_ready_push(pendtable, entry);
+        }
+        futexwait_wake(&entry->futexwait);
+    }
+    last = --entry->refs == 0;
+    pthread_mutex_unlock(&pendtable->mutex);
+
+    if (last)
+    {
+        pendtable_free(pendtable, entry);
+    }
+
+    return 0;
+}
+
+int pendtable_tryconsume(struct pendtable *pendtable,
+                         void *dstdata)
+{
+    struct pendentry *entry;
+    int result;
+
+    result = 0;
+
+    pthread_mutex_lock(&pendtable->mutex);
+    entry = pendtable->readyhead;
+    if (entry == NULL)
+    {
+        result = 1;
+        goto unlock;
+    }
+    pendtable_claim(pendtable, entry, dstdata);
+unlock:
+    pthread_mutex_unlock(&pendtable->mutex);
+
+    return result;
+}
+
+int pendtable_fd(struct pendtable *pendtable)
+{
+    return pendtable->notify.fd;
+}
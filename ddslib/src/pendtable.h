@@ -0,0 +1,99 @@
+#ifndef __PENDTABLE_H__
+#define __PENDTABLE_H__
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ddsmgr.h"
+#include "epstats.h"
+#include "futexwait.h"
+#include "notify.h"
+
+/*
+ * Hash table of pending requests keyed by request id.  Each registered
+ * request owns a result slot and its own futexwait, so a sample produced
+ * for one request wakes only the thread waiting on it.  The waiter parks
+ * without the table lock and holds a reference on the entry meanwhile; a
+ * request unregistered under it wakes it, fails its consume, and is freed
+ * by whichever of the two lets go last.  Samples
+ * whose request id is not registered are dropped.  The slot is seeded with
+ * the caller's initdata at registration, so convert() can find anything the
+ * caller provided in its dst argument.  A converted result is handed to
+ * exactly one consumer; if the request is unregistered before anyone
+ * consumed it, discard() is given the chance to free what convert()
+ * acquired.  Both callbacks receive cbarg as their first argument.
+ * convert() runs without the table lock, on an entry its producer has
+ * reserved, so it may be called concurrently for different requests.
+ *
+ * Completed but unclaimed entries registered as pollable are also kept on
+ * a ready list, in completion order, so that a single dispatcher can poll
+ * the table's fd and collect results with pendtable_tryconsume() instead
+ * of parking one thread per request in pendtable_consume().  Entries that
+ * are not pollable can only be collected by pendtable_consume(), which
+ * lets a caller wait on its own requests alongside such a dispatcher.
+ *
+ * Samples nobody takes, whether their id was never registered or the
+ * request was unregistered unconsumed, count as dropped_unknown in the
+ * table's epstats.  A sample for a request that already has its result is
+ * dropped as a duplicate.
+ */
+struct pendentry {
+    struct pendentry *next;
+    struct pendentry *readynext;
+    struct pendentry **readyprev;
+    struct futexwait futexwait;
+    int request_id;
+    unsigned int refs;
+    int unlinked;
+    int producing;
+    int complete;
+    int claimed;
+    int pollable;
+    uint64_t produced;
+    char data[];
+};
+
+struct pendtable {
+    pthread_mutex_t mutex;
+    unsigned int nbuckets;
+    struct pendentry **buckets;
+    struct pendentry *readyhead;
+    struct pendentry **readytail;
+    struct notify notify;
+    size_t slotsize;
+    void (*convert)(void *arg, void *dst, void *src);
+    void (*discard)(void *arg, void *data);
+    void *cbarg;
+    struct epstats *epstats;
+};
+
+/* Returned by pendtable_register() when request_id is already registered;
+ * any other failure returns 1. */
+#define PENDTABLE_EXISTS 2
+
+int pendtable_initialize(struct pendtable *pendtable,
+                         unsigned int nbuckets,
+                         size_t slotsize,
+                         void (*convert)(void *arg, void *dst, void *src),
+                         void (*discard)(void *arg, void *data),
+                         void *cbarg,
+                         struct epstats *epstats);
+void pendtable_destroy(struct pendtable *pendtable);
+int pendtable_register(struct pendtable *pendtable,
+                       int request_id,
+                       const void *initdata,
+                       int pollable);
+void pendtable_unregister(struct pendtable *pendtable,
+                          int request_id);
+int pendtable_consume(struct pendtable *pendtable,
+                      int request_id,
+                      void *dstdata,
+                      const struct abs_timeout *abstimo);
+int pendtable_tryconsume(struct pendtable *pendtable,
+                         void *dstdata);
+int pendtable_fd(struct pendtable *pendtable);
+int pendtable_produce(struct pendtable *pendtable,
+                      int request_id,
+                      void *srcdata);
+
+#endif
@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <string.h>
+#include "epstats.h"
+#include "pubqueue.h"
+
+static int pubqueue_take(struct pubqueue *pubqueue,
+                         struct pubslot **slotp)
+{
+    struct pubslot *slot;
+
+    slot = &pubqueue->slots[pubqueue->tail & pubqueue->mask];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) !=
+        pubqueue->tail + 1)
+    {
+        return 1;
+    }
+
+    *slotp = slot;
+
+    return 0;
+}
+
+static void pubqueue_return(struct pubqueue *pubqueue,
+                            struct pubslot *slot)
+{
+    free(slot->heap);
+    slot->heap = NULL;
+    atomic_store_explicit(&slot->seq, pubqueue->tail + pubqueue->mask + 1,
+                          memory_order_release);
+    pubqueue->tail++;
+}
+
+static void *pubqueue_writer(void *arg)
+{
+    struct pubqueue *pubqueue;
+    struct pubslot *slot;
+    unsigned int seq;
+    int status, batch;
+
+    pubqueue = arg;
+
+    for (;;)
+    {
+        seq = futexwait_prepare(&pubqueue->pending);
+
+        batch = 0;
+        while (pubqueue_take(pubqueue, &slot) == 0)
+        {
+            status = pubqueue->publish(pubqueue->cbarg, &slot->sample);
+            if (slot->sample.posted != NULL)
+            {
+                slot->sample.posted(slot->sample.arg,
+                                    slot->sample.request_id, status);
+            }
+            pubqueue_return(pubqueue, slot);
+            batch++;
+        }
+
+        if (batch)
+        {
+            atomic_store(&pubqueue->published, pubqueue->tail);
+            futexwait_wake(&pubqueue->completed);
+            continue;
+        }
+
+        if (!atomic_load(&pubqueue->running))
+        {
+            break;
+        }
+        futexwait_wait(&pubqueue->pending, seq, NULL);
+    }
+
+    return NULL;
+}
+
+int pubqueue_initialize(struct pubqueue *pubqueue,
+                        unsigned int depth,
+                        size_t bufsize,
+                        int (*publish)(void *arg,
+                                       const struct pubsample *sample),
+                        void *cbarg)
+{
+    unsigned int size, i;
+
+    if (depth == 0 || depth > (1u << 30))
+    {
+        return 1;
+    }
+    for (size = 1; size < depth; size <<= 1)
+    {
+    }
+
+    pubqueue->slots = calloc(size, sizeof(*pubqueue->slots));
+    if (pubqueue->slots == NULL)
+    {
+        return 1;
+    }
+
+    pubqueue->storage = malloc(size * bufsize);
+    if (pubqueue->storage == NULL && bufsize != 0)
+    {
+        free(pubqueue->slots);
+        return 1;
+    }
+
+    for (i = 0; i < size; i++)
+    {
+        atomic_init(&pubqueue->slots[i].seq, i);
+        pubqueue->slots[i].heap = NULL;
+        pubqueue->slots[i].storage = pubqueue->storage + i * bufsize;
+    }
+
+    pubqueue->mask = size - 1;
+    pubqueue->bufsize = bufsize;
+    atomic_init(&pubqueue->head, 0);
+    pubqueue->tail = 0;
+    atomic_init(&pubqueue->published, 0);
+    futexwait_initialize(&pubqueue->pending);
+    futexwait_initialize(&pubqueue->completed);
+    atomic_init(&pubqueue->running, 1);
+    pubqueue->publish = publish;
+    pubqueue->cbarg = cbarg;
+
+    if (pthread_create(&pubqueue->thread, NULL, pubqueue_writer, pubqueue))
+    {
+        free(pubqueue->storage);
+        free(pubqueue->slots);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Publishes whatever is still queued before the writer exits.
+ */
+void pubqueue_destroy(struct pubqueue *pubqueue)
+{
+    atomic_store(&pubqueue->running, 0);
+    futexwait_wake(&pubqueue->pending);
+    pthread_join(pubqueue->thread, NULL);
+
+    free(pubqueue->storage);
+    free(pubqueue->slots);
+    pubqueue->storage = NULL;
+    pubqueue->slots = NULL;
+}
+
+int pubqueue_post(struct pubqueue *pubqueue,
+                  const struct pubsample *sample,
+                  unsigned long long *token)
+{
+    struct pubslot *slot;
+    unsigned long long pos, seq;
+    char *data;
+
+    pos = atomic_load_explicit(&pubqueue->head, memory_order_relaxed);
+    for (;;)
+    {
+        slot = &pubqueue->slots[pos & pubqueue->mask];
+        seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == pos)
+        {
+            if (atomic_compare_exchange_weak_explicit(&pubqueue->head,
+                                                      &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if ((long long)(seq - pos) < 0)
+        {
+            return 1;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&pubqueue->head,
+                                       memory_order_relaxed);
+        }
+    }
+
+    data = slot->storage;
+    if ((size_t)sample->size > pubqueue->bufsize)
+    {
+        /* The slot is ours, so a failed allocation cannot give it back;
+         * the sample goes out without its payload and the writer reports
+         * the failure. */
+        slot->heap = malloc(sample->size);
+        data = slot->heap;
+    }
+
+    slot->sample = *sample;
+    slot->sample.data = data;
+    slot->sample.queued = epstats_now();
+    if (data != NULL)
+    {
+        memcpy(data, sample->data, sample->size);
+    }
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    futexwait_wake(&pubqueue->pending);
+
+    if (token != NULL)
+    {
+        *token = pos + 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Returns 0 once every sample up to and including the one token was
+ * issued for has been published, whether or not the publish succeeded.
+ */
+int pubqueue_wait(struct pubqueue *pubqueue,
+                  unsigned long long token,
+                  const struct abs_timeout *abstimo)
+{
+    unsigned int seq;
+
+    for (;;)
+    {
+        seq = futexwait_prepare(&pubqueue->completed);
+        if (atomic_load(&pubqueue->published) >= token)
+        {
+            return 0;
+        }
+        if (futexwait_wait(&pubqueue->completed, seq, abstimo))
+        {
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef __PUBQUEUE_H__
+#define __PUBQUEUE_H__
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include "ddsmgr.h"
+#include "futexwait.h"
+
+/*
+ * Bounded lock-free queue of samples waiting to be published, drained by
+ * a dedicated writer thread.  Producers claim a slot with one
+ * compare-and-swap on the enqueue position and copy their sample into it,
+ * so posting never blocks and never takes a lock; when every slot is
+ * occupied the post fails and the caller decides what to do.  Each slot
+ * carries its own sequence number, which tells producers and the writer
+ * whose turn it is without a shared lock (the bounded MPMC scheme of
+ * D. Vyukov, with a single consumer).
+ *
+ * The writer drains every sample queued by the time it wakes and
+ * publishes them back to back, then advances the published count and
+ * wakes waiters once per batch.  Because there is one writer, samples are
+ * published in enqueue order and a post's token, its position plus one,
+ * is complete as soon as the published count reaches it.
+ *
+ * Payloads of up to bufsize bytes are copied into storage owned by the
+ * slot; larger ones are copied to the heap.
+ */
+enum pubtype {
+    PUBTYPE_MCMD = 0,
+    PUBTYPE_PING = 1,
+};
+
+struct pubsample {
+    enum pubtype type;
+    int request_id;
+    char device_name[DDSMGR_DEVICE_NAME_LEN + 1];
+    const char *data;
+    int size;
+    uint64_t queued;
+    void (*posted)(void *arg, int request_id, int status);
+    void *arg;
+};
+
+struct pubslot {
+    atomic_ullong seq;
+    struct pubsample sample;
+    char *heap;
+    char *storage;
+};
+
+struct pubqueue {
+    struct pubslot *slots;
+    char *storage;
+    unsigned int mask;
+    size_t bufsize;
+    atomic_ullong head;
+    unsigned long long tail;
+    atomic_ullong published;
+    struct futexwait pending;
+    struct futexwait completed;
+    atomic_int running;
+    pthread_t thread;
+    int (*publish)(void *arg, const struct pubsample *sample);
+    void *cbarg;
+};
+
+int pubqueue_initialize(struct pubqueue *pubqueue,
+                        unsigned int depth,
+                        size_t bufsize,
+                        int (*publish)(void *arg,
+                                       const struct pubsample *sample),
+                        void *cbarg);
+void pubqueue_destroy(struct pubqueue *pubqueue);
+int pubqueue_post(struct pubqueue *pubqueue,
+                  const struct pubsample *sample,
+                  unsigned long long *token);
+int pubqueue_wait(struct pubqueue *pubqueue,
+                  unsigned long long token,
+                  const struct abs_timeout *abstimo);
+
+#endif
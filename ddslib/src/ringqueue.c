@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ringqueue.h"
+
+static void *ringqueue_slot(struct ringqueue *ringqueue, unsigned int index)
+{
+    return ringqueue->slots + (index % ringqueue->depth) * ringqueue->slotsize;
+}
+
+static void ringqueue_pop(struct ringqueue *ringqueue, void *dstdata)
+{
+    memcpy(dstdata,
+           ringqueue_slot(ringqueue, ringqueue->head),
+           ringqueue->slotsize);
+    epstats_wait(ringqueue->epstats, ringqueue->stamps[ringqueue->head]);
+    ringqueue->head = (ringqueue->head + 1) % ringqueue->depth;
+    ringqueue->count--;
+}
+
+int ringqueue_initialize(struct ringqueue *ringqueue,
+                         unsigned int depth,
+                         size_t slotsize,
+                         void (*convert)(void *dst, void *src),
+                         struct epstats *epstats)
+{
+    if (depth == 0)
+    {
+        return 1;
+    }
+
+    ringqueue->slots = calloc(depth, slotsize);
+    if (ringqueue->slots == NULL)
+    {
+        return 1;
+    }
+
+    ringqueue->stamps = calloc(depth, sizeof(*ringqueue->stamps));
+    if (ringqueue->stamps == NULL)
+    {
+        free(ringqueue->slots);
+        return 1;
+    }
+
+    if (notify_initialize(&ringqueue->notify))
+    {
+        free(ringqueue->stamps);
+        free(ringqueue->slots);
+        return 1;
+    }
+
+    pthread_mutex_init(&ringqueue->mutex, NULL);
+    futexwait_initialize(&ringqueue->futexwait);
+    ringqueue->enabled = 0;
+    ringqueue->depth = depth;
+    ringqueue->head = 0;
+    ringqueue->count = 0;
+    ringqueue->slotsize = slotsize;
+    ringqueue->convert = convert;
+    ringqueue->epstats = epstats;
+
+    return 0;
+}
+
+void ringqueue_destroy(struct ringqueue *ringqueue)
+{
+    notify_destroy(&ringqueue->notify);
+    pthread_mutex_destroy(&ringqueue->mutex);
+    free(ringqueue->stamps);
+    free(ringqueue->slots);
+    ringqueue->stamps = NULL;
+    ringqueue->slots = NULL;
+}
+
+int ringqueue_consume(struct ringqueue *ringqueue,
+                      void *dstdata,
+                      const struct abs_timeout *abstimo)
+{
+    unsigned int seq;
+    int result;
+
+    for (;;)
+    {
+        seq = futexwait_prepare(&ringqueue->futexwait);
+
+        pthread_mutex_lock(&ringqueue->mutex);
+        if (!ringqueue->enabled)
+        {
+            result = 1;
+            goto unlock;
+        }
+        if (ringqueue->count)
+        {
+            ringqueue_pop(ringqueue, dstdata);
+            result = 0;
+            goto unlock;
+        }
+        pthread_mutex_unlock(&ringqueue->mutex);
+
+        if (futexwait_wait(&ringqueue->futexwait, seq, abstimo))
+        {
+            epstats_add(&ringqueue->epstats->timeouts, 1);
+            return 1;
+        }
+    }
+
+unlock:
+    pthread_mutex_unlock(&ringqueue->mutex);
+
+    return result;
+}
+
+int ringqueue_produce(struct ringqueue *ringqueue,
+                      void *srcdata)
+{
+    unsigned int tail;
+    int result, wakeup;
+
+    result = 0;
+    wakeup = 0;
+
+    pthread_mutex_lock(&ringqueue->mutex);
+    if (!ringqueue->enabled)
+    {
+        epstats_add(&ringqueue->epstats->dropped_disabled, 1);
+        result = 1;
+        goto unlock;
+    }
+    if (ringqueue->count == ringqueue->depth)
+    {
+        epstats_add(&ringqueue->epstats->dropped_full, 1);
+        result = 1;
+        goto unlock;
+    }
+    tail = (ringqueue->head + ringqueue->count) % ringqueue->depth;
+    ringqueue->convert(ringqueue_slot(ringqueue, tail), srcdata);
+    ringqueue->stamps[tail] = epstats_now();
+    epstats_add(&ringqueue->epstats->converted, 1);
+    wakeup = !ringqueue->count;
+    ringqueue->count++;
+    if (wakeup)
+    {
+        notify_signal(&ringqueue->notify);
+    }
+unlock:
+    pthread_mutex_unlock(&ringqueue->mutex);
+
+    if (wakeup)
+    {
+        futexwait_wake(&ringqueue->futexwait);
+    }
+
+    return result;
+}
+
+int ringqueue_tryconsume(struct ringqueue *ringqueue,
+                         void *dstdata)
+{
+    int result;
+
+    result = 0;
+
+    pthread_mutex_lock(&ringqueue->mutex);
+    if (!ringqueue->enabled || !ringqueue->count)
+    {
+        result = 1;
+        goto unlock;
+    }
+    ringqueue_pop(ringqueue, dstdata);
+unlock:
+    pthread_mutex_unlock(&ringqueue->mutex);
+
+    return result;
+}
+
+int ringqueue_fd(struct ringqueue *ringqueue)
+{
+    return ringqueue->notify.fd;
+}
+
+void ringqueue_listen(struct ringqueue *ringqueue)
+{
+    pthread_mutex_lock(&ringqueue->mutex);
+    ringqueue->enabled = 1;
+    pthread_mutex_unlock(&ringqueue->mutex);
+}
+
+void ringqueue_reject(struct ringqueue *ringqueue)
+{
+    pthread_mutex_lock(&ringqueue->mutex);
+    ringqueue->enabled = 0;
+    epstats_add(&ringqueue->epstats->dropped_disabled, ringqueue->count);
+    ringqueue->head = 0;
+    ringqueue->count = 0;
+    pthread_mutex_unlock(&ringqueue->mutex);
+
+    futexwait_wake(&ringqueue->futexwait);
+}
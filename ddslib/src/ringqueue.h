@@ -0,0 +1,53 @@
+#ifndef __RINGQUEUE_H__
+#define __RINGQUEUE_H__
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ddsmgr.h"
+#include "epstats.h"
+#include "futexwait.h"
+#include "notify.h"
+
+/*
+ * Bounded multi-producer/single-consumer queue of preallocated slots.
+ * Producers convert their sample into a free slot and return immediately;
+ * when every slot is occupied the sample is dropped rather than blocking
+ * the producing (DDS listener) thread.  The consumer may either block in
+ * ringqueue_consume() or poll the queue's fd and drain it with
+ * ringqueue_tryconsume().  Drops, timeouts and the time each sample spent
+ * queued are counted in the caller's epstats.
+ */
+struct ringqueue {
+    pthread_mutex_t mutex;
+    struct futexwait futexwait;
+    int enabled;
+    unsigned int depth;
+    unsigned int head;
+    unsigned int count;
+    size_t slotsize;
+    char *slots;
+    uint64_t *stamps;
+    struct notify notify;
+    struct epstats *epstats;
+    void (*convert)(void *dst, void *src);
+};
+
+int ringqueue_initialize(struct ringqueue *ringqueue,
+                         unsigned int depth,
+                         size_t slotsize,
+                         void (*convert)(void *dst, void *src),
+                         struct epstats *epstats);
+void ringqueue_destroy(struct ringqueue *ringqueue);
+int ringqueue_consume(struct ringqueue *ringqueue,
+                      void *dstdata,
+                      const struct abs_timeout *abstimo);
+int ringqueue_tryconsume(struct ringqueue *ringqueue,
+                         void *dstdata);
+int ringqueue_fd(struct ringqueue *ringqueue);
+int ringqueue_produce(struct ringqueue *ringqueue,
+                      void *srcdata);
+void ringqueue_listen(struct ringqueue *ringqueue);
+void ringqueue_reject(struct ringqueue *ringqueue);
+
+#endif
@@ -0,0 +1,269 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "trace.h"
+
+atomic_int trace_active;
+
+static atomic_uint trace_generation;
+static atomic_uint trace_capacity;
+static _Atomic(struct tracebuf *) trace_buffers;
+static _Thread_local struct tracebuf *trace_local;
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+static int trace_key_failed;
+
+static const char *const trace_stage_names[DDSMGR_TRACE_STAGES] = {
+    [DDSMGR_TRACE_REQUEST] = "request",
+    [DDSMGR_TRACE_SEND]    = "send",
+    [DDSMGR_TRACE_QUEUE]   = "queue",
+    [DDSMGR_TRACE_PUBLISH] = "publish",
+    [DDSMGR_TRACE_DELIVER] = "deliver",
+    [DDSMGR_TRACE_WAKEUP]  = "wakeup",
+    [DDSMGR_TRACE_HANDOFF] = "handoff",
+    [DDSMGR_TRACE_RESPOND] = "respond",
+};
+
+/*
+ * Hands a thread's buffer back when the thread exits.  Its spans are still
+ * written out until the next trace_start().
+ */
+static void trace_release(void *arg)
+{
+    struct tracebuf *buf;
+
+    buf = arg;
+    atomic_store(&buf->owned, 0);
+}
+
+static void trace_key_create(void)
+{
+    trace_key_failed = pthread_key_create(&trace_key, trace_release) != 0;
+}
+
+/*
+ * Claims a handed back buffer of at least capacity spans that holds none
+ * of the given generation's spans, or returns NULL if there is none.
+ */
+static struct tracebuf *trace_reuse(unsigned int capacity,
+                                    unsigned int generation)
+{
+    struct tracebuf *buf;
+    int owned;
+
+    for (buf = atomic_load(&trace_buffers); buf != NULL; buf = buf->next)
+    {
+        owned = 0;
+        if (buf->capacity >= capacity &&
+            atomic_load(&buf->generation) != generation &&
+            atomic_compare_exchange_strong(&buf->owned, &owned, 1))
+        {
+            return buf;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Readies the calling thread's buffer for the given generation.  A buffer
+ * too small for the current capacity is handed back for a new one; it
+ * stays on the list but, being of an earlier generation, is never written
+ * out again.  Without a thread-exit hook to hand buffers back, buffers
+ * are neither handed back nor reused.
+ */
+static struct tracebuf *trace_buffer(struct tracebuf *buf,
+                                     unsigned int generation)
+{
+    struct tracebuf *reused;
+    unsigned int capacity;
+
+    capacity = atomic_load(&trace_capacity);
+    if (buf != NULL && buf->capacity >= capacity)
+    {
+        atomic_store(&buf->count, 0);
+        atomic_store(&buf->dropped, 0);
+        atomic_store(&buf->generation, generation);
+        return buf;
+    }
+
+    pthread_once(&trace_key_once, trace_key_create);
+    if (!trace_key_failed)
+    {
+        if (buf != NULL)
+        {
+            atomic_store(&buf->owned, 0);
+        }
+        reused = trace_reuse(capacity, generation);
+        if (reused != NULL)
+        {
+            reused->tid = syscall(SYS_gettid);
+            atomic_store(&reused->count, 0);
+            atomic_store(&reused->dropped, 0);
+            atomic_store(&reused->generation, generation);
+            pthread_setspecific(trace_key, reused);
+            trace_local = reused;
+            return reused;
+        }
+    }
+
+    buf = malloc(sizeof(*buf) + capacity * sizeof(buf->spans[0]));
+    if (buf == NULL)
+    {
+        return NULL;
+    }
+    buf->tid = syscall(SYS_gettid);
+    buf->capacity = capacity;
+    atomic_init(&buf->owned, 1);
+    atomic_init(&buf->generation, generation);
+    atomic_init(&buf->count, 0);
+    atomic_init(&buf->dropped, 0);
+
+    buf->next = atomic_load(&trace_buffers);
+    while (!atomic_compare_exchange_weak(&trace_buffers, &buf->next, buf))
+    {
+    }
+    if (!trace_key_failed)
+    {
+        pthread_setspecific(trace_key, buf);
+    }
+    trace_local = buf;
+
+    return buf;
+}
+
+int trace_start(unsigned int capacity)
+{
+    if (capacity == 0)
+    {
+        return 1;
+    }
+
+    atomic_store(&trace_capacity, capacity);
+    atomic_fetch_add(&trace_generation, 1);
+    atomic_store(&trace_active, 1);
+
+    return 0;
+}
+
+void trace_stop(void)
+{
+    atomic_store(&trace_active, 0);
+}
+
+void trace_record(int stage,
+                  int request_id,
+                  uint64_t start_ns,
+                  uint64_t end_ns)
+{
+    struct trace_span *span;
+    struct tracebuf *buf;
+    unsigned int generation, count;
+
+    if (!trace_on() || stage < 0 || stage >= DDSMGR_TRACE_STAGES)
+    {
+        return;
+    }
+
+    generation = atomic_load(&trace_generation);
+    buf = trace_local;
+    if (buf == NULL ||
+        atomic_load_explicit(&buf->generation,
+                             memory_order_relaxed) != generation)
+    {
+        buf = trace_buffer(buf, generation);
+        if (buf == NULL)
+        {
+            return;
+        }
+    }
+
+    count = atomic_load_explicit(&buf->count, memory_order_relaxed);
+    if (count == buf->capacity)
+    {
+        atomic_fetch_add_explicit(&buf->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    span = &buf->spans[count];
+    span->start_ns = start_ns;
+    span->end_ns = end_ns;
+    span->request_id = request_id;
+    span->stage = stage;
+    atomic_store_explicit(&buf->count, count + 1, memory_order_release);
+}
+
+static void trace_write_event(FILE *file,
+                              const struct trace_span *span,
+                              char phase,
+                              uint64_t stamp_ns,
+                              long tid)
+{
+    fprintf(file,
+            "{\"name\":\"%s\",\"cat\":\"ddsmgr\",\"ph\":\"%c\","
+            "\"id\":\"0x%x\",\"pid\":%ld,\"tid\":%ld,\"ts\":%llu.%03u}",
+            trace_stage_names[span->stage], phase,
+            (unsigned int)span->request_id, (long)getpid(), tid,
+            (unsigned long long)(stamp_ns / 1000),
+            (unsigned int)(stamp_ns % 1000));
+}
+
+/*
+ * Writes the current generation's spans as Chrome trace-event JSON, each
+ * span a pair of nestable async events keyed by its request id, so that a
+ * trace viewer lays out every request on a track of its own whichever
+ * threads its stages ran on.  Timestamps are CLOCK_MONOTONIC microseconds.
+ * Returns the number of spans written, or -1 if the file cannot be
+ * written.
+ */
+int trace_write(const char *path)
+{
+    struct tracebuf *buf;
+    unsigned long long dropped;
+    unsigned int generation, count, i;
+    FILE *file;
+    int written;
+
+    file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    generation = atomic_load(&trace_generation);
+    dropped = 0;
+    written = 0;
+
+    fputs("{\"traceEvents\":[", file);
+    for (buf = atomic_load(&trace_buffers); buf != NULL; buf = buf->next)
+    {
+        if (atomic_load(&buf->generation) != generation)
+        {
+            continue;
+        }
+
+        count = atomic_load_explicit(&buf->count, memory_order_acquire);
+        for (i = 0; i < count; i++)
+        {
+            fputs(written ? ",\n" : "\n", file);
+            trace_write_event(file, &buf->spans[i], 'b',
+                              buf->spans[i].start_ns, buf->tid);
+            fputs(",\n", file);
+            trace_write_event(file, &buf->spans[i], 'e',
+                              buf->spans[i].end_ns, buf->tid);
+            written++;
+        }
+        dropped += atomic_load(&buf->dropped);
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ns\","
+            "\"otherData\":{\"dropped_spans\":%llu}}\n", dropped);
+
+    if (fclose(file) != 0)
+    {
+        return -1;
+    }
+
+    return written;
+}
@@ -0,0 +1,65 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "ddsmgr.h"
+
+/*
+ * Process-wide span tracing.  A span is one stage of one request: the
+ * stage, the request id and its start and end on CLOCK_MONOTONIC.  Each
+ * thread appends to a buffer of its own, taken the first time it records
+ * while tracing is on, so recording takes no lock: the thread fills in the
+ * span and then publishes it by advancing the buffer's count with release
+ * semantics.  A full buffer drops further spans and counts them.
+ *
+ * Buffers are never freed, since trace_write() may be walking them, but a
+ * thread hands its buffer back when it exits.  A thread that needs a
+ * buffer reuses a handed back one that is large enough and whose spans
+ * are not part of the current generation, so the memory tracing holds is
+ * bounded by the threads that record at once rather than by every thread
+ * that ever recorded.
+ *
+ * Buffers are pushed onto a global list with a compare-and-swap on its
+ * head, and trace_write() walks that list.  Every trace_start() begins a
+ * new generation; a buffer from an earlier one is emptied the next time
+ * its thread records and is skipped by trace_write() until then.  A trace
+ * is therefore written between trace_stop() and the next trace_start().
+ *
+ * While tracing is off a trace point costs one relaxed load; callers test
+ * trace_on() before reading the clock.
+ */
+struct trace_span {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int32_t request_id;
+    uint32_t stage;
+};
+
+struct tracebuf {
+    struct tracebuf *next;
+    long tid;
+    unsigned int capacity;
+    atomic_int owned;
+    atomic_uint generation;
+    atomic_uint count;
+    atomic_ullong dropped;
+    struct trace_span spans[];
+};
+
+extern atomic_int trace_active;
+
+int trace_start(unsigned int capacity);
+void trace_stop(void);
+void trace_record(int stage,
+                  int request_id,
+                  uint64_t start_ns,
+                  uint64_t end_ns);
+int trace_write(const char *path);
+
+static inline int trace_on(void)
+{
+    return atomic_load_explicit(&trace_active, memory_order_relaxed);
+}
+
+#endif
@@ -110,6 +110,7 @@ func Commands() *cobra.Command {
 	nmCmd.AddCommand(echoCmd())
 	nmCmd.AddCommand(resCmd())
 	nmCmd.AddCommand(interactiveCmd())
+	nmCmd.AddCommand(ddsDaemonCmd())
 
 	return nmCmd
 }
@@ -0,0 +1,110 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package cli
+
+import (
+	"fmt"
+
+	"github.com/spf13/cobra"
+
+	"mynewt.apache.org/newt/util"
+	"mynewt.apache.org/newtmgr/newtmgr/config"
+	"mynewt.apache.org/newtmgr/nmxact/nmdds"
+)
+
+// Stands in for the daemon's transport as the global transport, so that
+// the cleanup on exit stops taking clients before it stops the transport
+// they use.
+type ddsDaemonXport struct {
+	*nmdds.DdsXport
+	daemon *nmdds.DdsDaemon
+}
+
+func (x *ddsDaemonXport) Stop() error {
+	if x.daemon != nil {
+		x.daemon.Close()
+	}
+
+	return x.DdsXport.Stop()
+}
+
+func ddsDaemonRunCmd(cmd *cobra.Command, args []string) {
+	cp, err := getConnProfile()
+	if err != nil {
+		nmUsage(nil, err)
+	}
+	if cp.Type != config.CONN_TYPE_DDS_PLAIN {
+		nmUsage(cmd, util.FmtNewtError(
+			"dds-daemon requires a dds connection profile"))
+	}
+
+	dc, err := config.ParseDdsConnString(cp.ConnString)
+	if err != nil {
+		nmUsage(nil, err)
+	}
+
+	// The daemon is the process that brings up DDS for everyone else.
+	socket := dc.DaemonSocket
+	if socket == "" {
+		socket = nmdds.DefaultDaemonSocket()
+	}
+	dc.DaemonSocket = ""
+
+	dx := &ddsDaemonXport{DdsXport: nmdds.NewDdsXport(dc)}
+	globalXport = dx
+	globalXportSet = true
+
+	if err := dx.Start(); err != nil {
+		nmUsage(nil, util.ChildNewtError(err))
+	}
+
+	d, err := nmdds.NewDdsDaemon(dx.DdsXport, socket)
+	if err != nil {
+		nmUsage(nil, util.ChildNewtError(err))
+	}
+	dx.daemon = d
+
+	// Runs until interrupted; the exit cleanup then closes the daemon,
+	// which removes the socket, and stops the transport.  A socket left
+	// behind by a daemon that was killed is replaced by the next one.
+	fmt.Printf("Serving dds on %s\n", socket)
+	if err := d.Serve(); err != nil {
+		nmUsage(nil, util.ChildNewtError(err))
+	}
+
+	// Serve only returns nil once the exit cleanup has closed the daemon;
+	// wait for that cleanup instead of running a second one.
+	NmExit(0)
+}
+
+func ddsDaemonCmd() *cobra.Command {
+	ddsDaemonCmd := &cobra.Command{
+		Use: "dds-daemon -c <conn_profile>",
+		Short: "Keep the dds transport up for other " +
+			"newtmgr invocations to use",
+		Long: "Brings up the dds transport and serves it to newtmgr " +
+			"commands run by the same user with dds connection profiles " +
+			"that set daemon=true, which then skip endpoint matching and " +
+			"device discovery.",
+		Run: ddsDaemonRunCmd,
+	}
+
+	return ddsDaemonCmd
+}
@@ -20,19 +20,86 @@
 package config
 
 import (
+	"fmt"
+	"strconv"
+	"strings"
+
 	"mynewt.apache.org/newtmgr/newtmgr/nmutil"
 	"mynewt.apache.org/newtmgr/nmxact/nmdds"
 	"mynewt.apache.org/newt/util"
 )
 
+func einvalDdsConnString(f string, args ...interface{}) error {
+	suffix := fmt.Sprintf(f, args...)
+	return util.FmtNewtError("Invalid dds connstring; %s", suffix)
+}
+
+// Keys a dds connstring may set.
+var ddsConnStringKeys = []string{"target", "daemon", "daemonsock"}
+
+// Returns the key a "key=value" part of a dds connstring sets, or "" if p
+// does not start with a recognized key.
+func ddsConnStringKey(p string) string {
+	for _, k := range ddsConnStringKeys {
+		if strings.HasPrefix(p, k+"=") {
+			return k
+		}
+	}
+
+	return ""
+}
+
+// Parses a dds connstring.  One that does not start with a recognized
+// "key=" is the old form: the whole string is the regex matched against
+// device names, commas and equals signs included.  Otherwise it is a
+// comma-separated list of key=value pairs; a part that does not start
+// with a recognized key belongs to the previous value, so that a target
+// regex may still contain commas, e.g. "target=dev[0-9]{1,2},daemon=1".
 func ParseDdsConnString(cs string) (*nmdds.XportCfg, error) {
 	if cs == "" {
-		return nil, util.FmtNewtError("Invalid dds connstring; cannot be empty")
+		return nil, einvalDdsConnString("cannot be empty")
 	}
 
 	dc := nmdds.NewXportCfg()
 	dc.CommTimeout = nmutil.TxOptions().Timeout
-	dc.TargetMatch = cs
+
+	if ddsConnStringKey(cs) == "" {
+		dc.TargetMatch = cs
+		return dc, nil
+	}
+
+	var kvs [][2]string
+	for _, p := range strings.Split(cs, ",") {
+		k := ddsConnStringKey(p)
+		if k == "" {
+			kvs[len(kvs)-1][1] += "," + p
+			continue
+		}
+		kvs = append(kvs, [2]string{k, p[len(k)+1:]})
+	}
+
+	for _, kv := range kvs {
+		k := kv[0]
+		v := kv[1]
+
+		switch k {
+		case "target":
+			dc.TargetMatch = v
+
+		case "daemon":
+			use, err := strconv.ParseBool(v)
+			if err != nil {
+				return dc, einvalDdsConnString("Invalid daemon: %s", v)
+			}
+			dc.DaemonSocket = ""
+			if use {
+				dc.DaemonSocket = nmdds.DefaultDaemonSocket()
+			}
+
+		case "daemonsock":
+			dc.DaemonSocket = v
+		}
+	}
 
 	return dc, nil
 }
@@ -0,0 +1,196 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package nmdds
+
+import (
+	"reflect"
+	"sync"
+	"time"
+
+	"mynewt.apache.org/newtmgr/nmxact/nmp"
+	"mynewt.apache.org/newtmgr/nmxact/nmxutil"
+)
+
+// Evicting expired cache entries is deferred until the cache holds this many.
+const readCacheSweep = 256
+
+// Shares read-only NMP requests between callers.  The first caller to issue
+// a request sends it; callers that issue an identical request to the same
+// device while it is in flight wait for its response instead of sending
+// their own.  With a nonzero TTL, successful responses are also served to
+// identical requests for that long after they arrive.  A caller that shares
+// a response gets a shallow copy carrying its own sequence number; the
+// rest of the decoded value is shared, so it must not be modified.
+type readCoalescer struct {
+	ttl      time.Duration
+	mtx      sync.Mutex
+	inflight map[string]*readCall
+	cache    map[string]readCacheEntry
+}
+
+type readCall struct {
+	done chan struct{}
+	rsp  nmp.NmpRsp
+	err  error
+}
+
+type readCacheEntry struct {
+	rsp     nmp.NmpRsp
+	expires time.Time
+}
+
+func newReadCoalescer(ttl time.Duration) *readCoalescer {
+	return &readCoalescer{
+		ttl:      ttl,
+		inflight: map[string]*readCall{},
+		cache:    map[string]readCacheEntry{},
+	}
+}
+
+// Identifies a request by everything but its sequence number, which differs
+// between otherwise identical requests.  scope is empty for requests that
+// any session may share, or names the only session that may share them,
+// e.g. one whose filters rewrite its requests or responses.  Returns "" if
+// the request is not a read or its body cannot be encoded.
+func readKey(scope string, devname string, m *nmp.NmpMsg) string {
+	if m.Hdr.Op != nmp.NMP_OP_READ {
+		return ""
+	}
+
+	body, err := nmp.BodyBytes(m.Body)
+	if err != nil {
+		return ""
+	}
+
+	key := make([]byte, 0, len(scope)+len(devname)+6+len(body))
+	key = append(key, scope...)
+	key = append(key, 0)
+	key = append(key, devname...)
+	key = append(key, 0, byte(m.Hdr.Group>>8), byte(m.Hdr.Group),
+		m.Hdr.Id, m.Hdr.Flags)
+	key = append(key, body...)
+
+	return string(key)
+}
+
+// Returns a shallow copy of rsp whose header carries seq, or rsp itself if
+// it already does.
+func rspWithSeq(rsp nmp.NmpRsp, seq uint8) nmp.NmpRsp {
+	if rsp == nil || rsp.Hdr().Seq == seq {
+		return rsp
+	}
+
+	v := reflect.ValueOf(rsp)
+	if v.Kind() != reflect.Ptr {
+		return rsp
+	}
+	c := reflect.New(v.Elem().Type())
+	c.Elem().Set(v.Elem())
+
+	cp := c.Interface().(nmp.NmpRsp)
+	hdr := *rsp.Hdr()
+	hdr.Seq = seq
+	cp.SetHdr(&hdr)
+
+	return cp
+}
+
+// Returns the response to the request identified by key, calling fn to send
+// it only if no identical request is in flight or cached.  fn is given the
+// time left of timeout; zero means no limit.  A caller that waits on
+// another's request gives up after timeout, and sends its own if that
+// request timed out while it still has time left.  seq is the caller's
+// sequence number, which a shared response is given.  shared reports
+// whether the response came from another caller or the cache.
+func (c *readCoalescer) do(key string, seq uint8, timeout time.Duration,
+	fn func(timeout time.Duration) (nmp.NmpRsp, error)) (
+	rsp nmp.NmpRsp, shared bool, err error) {
+
+	var deadline time.Time
+	var expired <-chan time.Time
+	if timeout != 0 {
+		deadline = time.Now().Add(timeout)
+		timer := time.NewTimer(timeout)
+		defer timer.Stop()
+		expired = timer.C
+	}
+
+	var call *readCall
+	for {
+		c.mtx.Lock()
+		if e, ok := c.cache[key]; ok {
+			if time.Now().Before(e.expires) {
+				c.mtx.Unlock()
+				return rspWithSeq(e.rsp, seq), true, nil
+			}
+			delete(c.cache, key)
+		}
+
+		call = c.inflight[key]
+		if call == nil {
+			break
+		}
+		c.mtx.Unlock()
+
+		select {
+		case <-call.done:
+		case <-expired:
+			return nil, true, nmxutil.NewRspTimeoutError("NMP timeout")
+		}
+
+		// The sender may have allowed itself less time than this caller.
+		if !nmxutil.IsRspTimeout(call.err) {
+			return rspWithSeq(call.rsp, seq), true, call.err
+		}
+	}
+
+	if timeout != 0 {
+		timeout = time.Until(deadline)
+		if timeout <= 0 {
+			c.mtx.Unlock()
+			return nil, false, nmxutil.NewRspTimeoutError("NMP timeout")
+		}
+	}
+
+	call = &readCall{done: make(chan struct{})}
+	c.inflight[key] = call
+	c.mtx.Unlock()
+
+	call.rsp, call.err = fn(timeout)
+
+	c.mtx.Lock()
+	delete(c.inflight, key)
+	if call.err == nil && c.ttl > 0 {
+		now := time.Now()
+		if len(c.cache) >= readCacheSweep {
+			for k, e := range c.cache {
+				if !now.Before(e.expires) {
+					delete(c.cache, k)
+				}
+			}
+		}
+		c.cache[key] = readCacheEntry{call.rsp, now.Add(c.ttl)}
+	}
+	c.mtx.Unlock()
+
+	close(call.done)
+
+	return call.rsp, false, call.err
+}
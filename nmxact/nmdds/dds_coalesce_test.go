@@ -0,0 +1,276 @@
+//go:build ddsloopback
+// +build ddsloopback
+
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// The coalescer does not touch DDS, but the package only links against a
+// libddsmgr.a; see ddslib/Makefile for how to build the loopback one.
+
+package nmdds
+
+import (
+	"errors"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"mynewt.apache.org/newtmgr/nmxact/nmp"
+	"mynewt.apache.org/newtmgr/nmxact/nmxutil"
+)
+
+func statReadMsg(name string) *nmp.NmpMsg {
+	r := nmp.NewStatReadReq()
+	r.Name = name
+	return r.Msg()
+}
+
+func TestReadKey(t *testing.T) {
+	a := statReadMsg("stat")
+	b := statReadMsg("stat")
+	if a.Hdr.Seq == b.Hdr.Seq {
+		t.Fatal("requests share a sequence number")
+	}
+
+	// The sequence number is the only thing that may differ.
+	key := readKey("", "dev0", a)
+	if key == "" || readKey("", "dev0", b) != key {
+		t.Fatalf("identical reads have keys %q and %q", key,
+			readKey("", "dev0", b))
+	}
+	scoped := readKey("sesn", "dev0", a)
+	if scoped == "" || readKey("sesn", "dev0", b) != scoped {
+		t.Fatal("identical reads in one scope have different keys")
+	}
+
+	flagged := statReadMsg("stat")
+	flagged.Hdr.Flags = 1
+
+	distinct := map[string]string{
+		"device": readKey("", "dev1", a),
+		"scope":  scoped,
+		"body":   readKey("", "dev0", statReadMsg("other")),
+		"group":  readKey("", "dev0", nmp.NewTaskStatReq().Msg()),
+		"flags":  readKey("", "dev0", flagged),
+	}
+	for what, k := range distinct {
+		if k == "" || k == key {
+			t.Fatalf("reads that differ in %s share a key", what)
+		}
+	}
+
+	if k := readKey("", "dev0", nmp.NewConfigWriteReq().Msg()); k != "" {
+		t.Fatalf("write coalesced under key %q", k)
+	}
+}
+
+// Returns a response to the request with sequence number seq, as the
+// transceiver would.
+func taskStatRsp(seq uint8) *nmp.TaskStatRsp {
+	r := nmp.NewTaskStatRsp()
+	r.Hdr().Seq = seq
+	r.Rc = 7
+	return r
+}
+
+func TestReadCoalescerShares(t *testing.T) {
+	c := newReadCoalescer(0)
+	release := make(chan struct{})
+	var sends int32
+
+	send := func(seq uint8) func(time.Duration) (nmp.NmpRsp, error) {
+		return func(time.Duration) (nmp.NmpRsp, error) {
+			atomic.AddInt32(&sends, 1)
+			<-release
+			return taskStatRsp(seq), nil
+		}
+	}
+
+	// Every caller that arrives while the first is in flight shares its
+	// response, under its own sequence number.
+	var wg sync.WaitGroup
+	var started, shared int32
+	rsps := make([]nmp.NmpRsp, 16)
+	for i := range rsps {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			atomic.AddInt32(&started, 1)
+			rsp, s, err := c.do("key", uint8(i), time.Second,
+				send(uint8(i)))
+			if err != nil {
+				t.Error(err)
+			}
+			if s {
+				atomic.AddInt32(&shared, 1)
+			}
+			rsps[i] = rsp
+		}(i)
+	}
+	for atomic.LoadInt32(&started) != int32(len(rsps)) {
+		time.Sleep(time.Millisecond)
+	}
+	time.Sleep(20 * time.Millisecond)
+	close(release)
+	wg.Wait()
+
+	if sends != 1 || shared != int32(len(rsps)-1) {
+		t.Fatalf("%d sends, %d shared", sends, shared)
+	}
+	for i, rsp := range rsps {
+		r, ok := rsp.(*nmp.TaskStatRsp)
+		if !ok || r.Rc != 7 {
+			t.Fatalf("caller %d received %+v", i, rsp)
+		}
+		if r.Hdr().Seq != uint8(i) {
+			t.Fatalf("caller %d received sequence number %d", i,
+				r.Hdr().Seq)
+		}
+	}
+
+	// Without a TTL, nothing is served once the request has completed.
+	if _, s, _ := c.do("key", 1, time.Second, send(1)); s || sends != 2 {
+		t.Fatalf("served from a disabled cache, %d sends", sends)
+	}
+}
+
+func TestReadCoalescerCache(t *testing.T) {
+	c := newReadCoalescer(50 * time.Millisecond)
+	var sends int32
+	fail := errors.New("failed")
+
+	send := func(time.Duration) (nmp.NmpRsp, error) {
+		atomic.AddInt32(&sends, 1)
+		return nmp.NewTaskStatRsp(), nil
+	}
+	sendFail := func(time.Duration) (nmp.NmpRsp, error) {
+		atomic.AddInt32(&sends, 1)
+		return nil, fail
+	}
+
+	c.do("key", 1, time.Second, send)
+	if _, s, _ := c.do("key", 1, time.Second, send); !s || sends != 1 {
+		t.Fatalf("not served from the cache, %d sends", sends)
+	}
+
+	time.Sleep(60 * time.Millisecond)
+	if _, s, _ := c.do("key", 1, time.Second, send); s || sends != 2 {
+		t.Fatalf("served an expired entry, %d sends", sends)
+	}
+
+	// Failures are not cached.
+	if _, _, err := c.do("other", 1, time.Second, sendFail); err != fail {
+		t.Fatalf("expected the send's error, got %v", err)
+	}
+	if _, s, _ := c.do("other", 1, time.Second, send); s || sends != 4 {
+		t.Fatalf("served a failure from the cache, %d sends", sends)
+	}
+}
+
+func TestReadCoalescerWaitTimeout(t *testing.T) {
+	c := newReadCoalescer(0)
+	release := make(chan struct{})
+	done := make(chan error)
+
+	go func() {
+		_, _, err := c.do("key", 1, 0,
+			func(time.Duration) (nmp.NmpRsp, error) {
+				<-release
+				return nmp.NewTaskStatRsp(), nil
+			})
+		done <- err
+	}()
+	for {
+		c.mtx.Lock()
+		call := c.inflight["key"]
+		c.mtx.Unlock()
+		if call != nil {
+			break
+		}
+		time.Sleep(time.Millisecond)
+	}
+
+	// A waiter gives up on its own timeout; the sender carries on.
+	_, s, err := c.do("key", 2, 10*time.Millisecond,
+		func(time.Duration) (nmp.NmpRsp, error) {
+			t.Error("identical request sent while one is in flight")
+			return nil, nil
+		})
+	if !s || !nmxutil.IsRspTimeout(err) {
+		t.Fatalf("expected a shared timeout, got %v", err)
+	}
+
+	close(release)
+	if err := <-done; err != nil {
+		t.Fatal(err)
+	}
+}
+
+// A waiter whose sender timed out sends its own request with the time it
+// has left instead of sharing the timeout.
+func TestReadCoalescerRetry(t *testing.T) {
+	c := newReadCoalescer(0)
+	release := make(chan struct{})
+	done := make(chan error)
+
+	go func() {
+		_, _, err := c.do("key", 1, 10*time.Millisecond,
+			func(time.Duration) (nmp.NmpRsp, error) {
+				<-release
+				return nil, nmxutil.NewRspTimeoutError("NMP timeout")
+			})
+		done <- err
+	}()
+	for {
+		c.mtx.Lock()
+		call := c.inflight["key"]
+		c.mtx.Unlock()
+		if call != nil {
+			break
+		}
+		time.Sleep(time.Millisecond)
+	}
+
+	var left time.Duration
+	result := make(chan error)
+	go func() {
+		rsp, s, err := c.do("key", 2, time.Second,
+			func(timeout time.Duration) (nmp.NmpRsp, error) {
+				left = timeout
+				return taskStatRsp(2), nil
+			})
+		if err == nil && (s || rsp.Hdr().Seq != 2) {
+			err = errors.New("retry did not send its own request")
+		}
+		result <- err
+	}()
+	time.Sleep(20 * time.Millisecond)
+	close(release)
+
+	if err := <-done; !nmxutil.IsRspTimeout(err) {
+		t.Fatalf("expected the sender to time out, got %v", err)
+	}
+	if err := <-result; err != nil {
+		t.Fatal(err)
+	}
+	if left <= 0 || left > time.Second-20*time.Millisecond {
+		t.Fatalf("retry was given %v", left)
+	}
+}
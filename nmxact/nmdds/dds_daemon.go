@@ -0,0 +1,428 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package nmdds
+
+import (
+	"fmt"
+	"net"
+	"net/rpc"
+	"os"
+	"path/filepath"
+	"sync"
+	"syscall"
+	"time"
+)
+
+// Returns the Unix socket a dds daemon listens on unless told otherwise,
+// one per user: newtmgr/dds.sock under $XDG_RUNTIME_DIR, or under a
+// newtmgr-<uid> directory in the temporary directory if that is unset.
+func DefaultDaemonSocket() string {
+	if dir := os.Getenv("XDG_RUNTIME_DIR"); dir != "" {
+		return filepath.Join(dir, "newtmgr", "dds.sock")
+	}
+
+	return filepath.Join(os.TempDir(),
+		fmt.Sprintf("newtmgr-%d", os.Getuid()), "dds.sock")
+}
+
+// Creates the directory a daemon socket goes in, or checks an existing
+// one.  Only the user may own or enter it: anyone else could otherwise
+// replace the socket with their own between the daemon binding it and a
+// client connecting.
+func makeSocketDir(path string) error {
+	dir := filepath.Dir(path)
+	if err := os.Mkdir(dir, 0700); err != nil && !os.IsExist(err) {
+		return err
+	}
+
+	fi, err := os.Lstat(dir)
+	if err != nil {
+		return err
+	}
+	st, ok := fi.Sys().(*syscall.Stat_t)
+	if !fi.IsDir() || !ok || int(st.Uid) != os.Getuid() ||
+		fi.Mode().Perm()&0077 != 0 {
+
+		return fmt.Errorf("%s is not a directory private to this user", dir)
+	}
+
+	return nil
+}
+
+// Time a client allows a call beyond the time the daemon may spend on it,
+// for the round trip over the socket.
+const daemonCallSlack = time.Second
+
+// Arguments and results of the calls a DdsDaemon serves.  Each call uses
+// only the fields it needs.  Timeout and Window are the client's
+// CommTimeout and DiscoverWindow, which the daemon applies in place of its
+// own, so that the client knows how long a call may take.  Retransmits is
+// how often the client allows its command to be sent again.
+type DaemonRequest struct {
+	Device      string
+	Devices     []string
+	TargetMatch string
+	Pattern     string
+	Bytes       []byte
+	Timeout     time.Duration
+	Window      time.Duration
+	Retransmits int
+}
+
+type DaemonReply struct {
+	Device  string
+	Found   bool
+	Devices []DdsDevice
+	Rsp     []byte
+	Fanout  []DaemonFanoutResult
+	Stats   DdsStats
+}
+
+// Outcome of a fanned-out command for one device.  Err is empty if the
+// device responded.
+type DaemonFanoutResult struct {
+	Device string
+	Rsp    []byte
+	Err    string
+}
+
+// Serves a started DdsXport to newtmgr processes on the same machine over
+// a Unix socket.  The daemon keeps its DDS participant, matched endpoints
+// and device registry for as long as it runs, so a client's
+// DdsXport.Start costs a connect and a registry lookup instead of
+// endpoint matching and a ping.  Commands from every client go through
+// the daemon's transport, so its RTT estimates and retransmissions carry
+// over from one client process to the next.
+type DdsDaemon struct {
+	listener  net.Listener
+	server    *rpc.Server
+	closed    chan struct{}
+	closeOnce sync.Once
+}
+
+// The calls a DdsDaemon serves: each does for a client what the client's
+// DdsXport would have done in process.
+type daemonService struct {
+	dx *DdsXport
+}
+
+// Listens on the Unix socket at path.  The socket's directory is created
+// if needed and must be private to the user.
+func NewDdsDaemon(dx *DdsXport, path string) (*DdsDaemon, error) {
+	if err := makeSocketDir(path); err != nil {
+		return nil, err
+	}
+
+	if conn, err := net.Dial("unix", path); err == nil {
+		conn.Close()
+		return nil, fmt.Errorf("A dds daemon is already listening on %s",
+			path)
+	}
+
+	// Nobody answers on a socket left behind by a daemon that died.
+	os.Remove(path)
+
+	server := rpc.NewServer()
+	if err := server.RegisterName("DdsDaemon",
+		&daemonService{dx}); err != nil {
+
+		return nil, err
+	}
+
+	// The socket is bound inside the private directory, so nobody else
+	// can reach it even before its own permissions are narrowed.
+	listener, err := net.Listen("unix", path)
+	if err != nil {
+		return nil, err
+	}
+	if err := os.Chmod(path, 0600); err != nil {
+		listener.Close()
+		return nil, err
+	}
+
+	return &DdsDaemon{
+		listener: listener,
+		server:   server,
+		closed:   make(chan struct{}),
+	}, nil
+}
+
+// Serves clients until Close() is called, then returns nil.
+func (d *DdsDaemon) Serve() error {
+	for {
+		conn, err := d.listener.Accept()
+		if err != nil {
+			select {
+			case <-d.closed:
+				return nil
+			default:
+				return err
+			}
+		}
+		if err := checkPeer(conn); err != nil {
+			conn.Close()
+			continue
+		}
+		go d.server.ServeConn(conn)
+	}
+}
+
+// Stops accepting clients and removes the socket.  The daemon's transport
+// is left to its owner to stop.
+func (d *DdsDaemon) Close() error {
+	var err error
+
+	d.closeOnce.Do(func() {
+		close(d.closed)
+		err = d.listener.Close()
+	})
+
+	return err
+}
+
+func (s *daemonService) Attach(req DaemonRequest, reply *DaemonReply) error {
+	devname, err := s.dx.matchTarget(req.TargetMatch, req.Window)
+	reply.Device = devname
+
+	return err
+}
+
+func (s *daemonService) Lookup(req DaemonRequest, reply *DaemonReply) error {
+	dev, found := s.dx.LookupDevice(req.Device)
+	reply.Found = found
+	if found {
+		reply.Devices = []DdsDevice{dev}
+	}
+
+	return nil
+}
+
+func (s *daemonService) Devices(req DaemonRequest, reply *DaemonReply) error {
+	reply.Devices = s.dx.Devices()
+
+	return nil
+}
+
+func (s *daemonService) Match(req DaemonRequest, reply *DaemonReply) error {
+	reply.Devices = s.dx.MatchDevices(req.Pattern)
+
+	return nil
+}
+
+func (s *daemonService) Discover(req DaemonRequest, reply *DaemonReply) error {
+	devs, err := s.dx.discover(req.Window)
+	reply.Devices = devs
+
+	return err
+}
+
+func (s *daemonService) Tx(req DaemonRequest, reply *DaemonReply) error {
+	return s.dx.tx(req.Device, req.Bytes, req.Timeout)
+}
+
+func (s *daemonService) TxRx(req DaemonRequest, reply *DaemonReply) error {
+	return s.dx.txRx(req.Device, req.Bytes, req.Timeout, req.Retransmits,
+		func(rsp []byte) error {
+			reply.Rsp = append([]byte{}, rsp...)
+			return nil
+		})
+}
+
+func (s *daemonService) TxFanout(req DaemonRequest,
+	reply *DaemonReply) error {
+
+	// The responses go straight into their device's slot, which the
+	// failures are then filled in around.
+	reply.Fanout = make([]DaemonFanoutResult, len(req.Devices))
+	results, err := s.dx.txFanout(req.Devices, req.Bytes, req.Timeout,
+		func(i int, rsp []byte) error {
+			reply.Fanout[i].Rsp = append([]byte{}, rsp...)
+			return nil
+		})
+	if err != nil {
+		reply.Fanout = nil
+		return err
+	}
+
+	for i, r := range results {
+		reply.Fanout[i].Device = r.Device
+		if r.Err != nil {
+			reply.Fanout[i].Err = r.Err.Error()
+		}
+	}
+
+	return nil
+}
+
+func (s *daemonService) Stats(req DaemonRequest, reply *DaemonReply) error {
+	stats, err := s.dx.Stats()
+	reply.Stats = stats
+
+	return err
+}
+
+// A DdsXport's connection to a DdsDaemon.  Calls from concurrent
+// goroutines share the connection and are answered independently.
+type daemonClient struct {
+	rpc     *rpc.Client
+	timeout time.Duration
+	window  time.Duration
+}
+
+func dialDaemon(path string, timeout time.Duration,
+	window time.Duration) (*daemonClient, error) {
+
+	conn, err := net.DialTimeout("unix", path, time.Second)
+	if err != nil {
+		return nil, err
+	}
+	if err := checkPeer(conn); err != nil {
+		conn.Close()
+		return nil, err
+	}
+
+	return &daemonClient{
+		rpc:     rpc.NewClient(conn),
+		timeout: timeout,
+		window:  window,
+	}, nil
+}
+
+func (c *daemonClient) close() {
+	c.rpc.Close()
+}
+
+// Calls the daemon and waits for its reply for at most limit, plus
+// daemonCallSlack.  The daemon bounds each call by the client's own
+// timeouts, so a call only runs out here if the daemon is stuck.
+func (c *daemonClient) call(method string, req DaemonRequest,
+	limit time.Duration) (DaemonReply, error) {
+
+	// A reply that arrives after the deadline is decoded into this, which
+	// is no longer read by then.
+	reply := &DaemonReply{}
+
+	req.Timeout = c.timeout
+	req.Window = c.window
+	call := c.rpc.Go("DdsDaemon."+method, req, reply,
+		make(chan *rpc.Call, 1))
+
+	timer := time.NewTimer(limit + daemonCallSlack)
+	defer timer.Stop()
+
+	select {
+	case <-call.Done:
+		return *reply, call.Error
+	case <-timer.C:
+		return DaemonReply{}, fmt.Errorf(
+			"dds daemon did not answer %s within %s", method,
+			limit+daemonCallSlack)
+	}
+}
+
+func (c *daemonClient) attach(targetMatch string) (string, error) {
+	reply, err := c.call("Attach", DaemonRequest{TargetMatch: targetMatch},
+		c.timeout+c.window)
+
+	return reply.Device, err
+}
+
+func (c *daemonClient) lookup(devname string) (DdsDevice, bool) {
+	reply, err := c.call("Lookup", DaemonRequest{Device: devname},
+		c.timeout)
+	if err != nil || !reply.Found {
+		return DdsDevice{}, false
+	}
+
+	return reply.Devices[0], true
+}
+
+func (c *daemonClient) devices(method string, pattern string) []DdsDevice {
+	reply, err := c.call(method, DaemonRequest{Pattern: pattern},
+		c.timeout)
+	if err != nil {
+		return nil
+	}
+
+	return reply.Devices
+}
+
+func (c *daemonClient) discover() ([]DdsDevice, error) {
+	reply, err := c.call("Discover", DaemonRequest{}, c.timeout+c.window)
+
+	return reply.Devices, err
+}
+
+func (c *daemonClient) tx(devname string, bytes []byte) error {
+	_, err := c.call("Tx", DaemonRequest{Device: devname, Bytes: bytes},
+		c.timeout)
+
+	return err
+}
+
+func (c *daemonClient) txRx(devname string, bytes []byte, retransmits int,
+	rxCb func(rsp []byte) error) error {
+
+	reply, err := c.call("TxRx", DaemonRequest{
+		Device:      devname,
+		Bytes:       bytes,
+		Retransmits: retransmits,
+	}, c.timeout)
+	if err != nil {
+		return err
+	}
+
+	return rxCb(reply.Rsp)
+}
+
+func (c *daemonClient) txFanout(devnames []string, bytes []byte,
+	rxCb func(i int, rsp []byte) error) (
+	[]DdsFanoutResult, error) {
+
+	reply, err := c.call("TxFanout", DaemonRequest{
+		Devices: devnames,
+		Bytes:   bytes,
+	}, c.timeout)
+	if err != nil {
+		return nil, err
+	}
+	if len(reply.Fanout) != len(devnames) {
+		return nil, fmt.Errorf("dds daemon returned %d fanout results "+
+			"for %d devices", len(reply.Fanout), len(devnames))
+	}
+
+	results := make([]DdsFanoutResult, len(reply.Fanout))
+	for i, r := range reply.Fanout {
+		results[i].Device = r.Device
+		if r.Err != "" {
+			results[i].Err = fmt.Errorf("%s", r.Err)
+		} else {
+			results[i].Err = rxCb(i, r.Rsp)
+		}
+	}
+
+	return results, nil
+}
+
+func (c *daemonClient) stats() (DdsStats, error) {
+	reply, err := c.call("Stats", DaemonRequest{}, c.timeout)
+
+	return reply.Stats, err
+}
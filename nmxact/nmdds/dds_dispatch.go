@@ -0,0 +1,141 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package nmdds
+
+// #include "../../ddslib/src/ddsmgr.h"
+import "C"
+
+import (
+	"fmt"
+	"os"
+	"sync"
+	"syscall"
+)
+
+// Routes MRsp samples to the goroutines waiting on them.  A single
+// goroutine parks on the ddsmgr response fd in the Go poller and drains
+// completed responses when it becomes readable, so waiting for a response
+// does not tie up an OS thread inside cgo.
+type mrspDispatcher struct {
+	ctx     *C.struct_ddsmgr_ctx
+	file    *os.File
+	mtx     sync.Mutex
+	waiters map[int32]chan mrspDelivery
+	stopped chan struct{}
+}
+
+// A response on its way to its waiter.  taken is the trace clock when the
+// dispatcher took it from ddsmgr, zero when not tracing.
+type mrspDelivery struct {
+	mrsp  C.struct_packet_mrsp
+	taken C.ulonglong
+}
+
+func newMrspDispatcher(ctx *C.struct_ddsmgr_ctx) (*mrspDispatcher, error) {
+	// The context owns its fd; the dispatcher polls and closes a duplicate.
+	fd, err := syscall.Dup(int(C.ddsmgr_mrsp_fd(ctx)))
+	if err != nil {
+		return nil, fmt.Errorf("Failed to duplicate ddsmgr fd: %s",
+			err.Error())
+	}
+	syscall.CloseOnExec(fd)
+
+	d := &mrspDispatcher{
+		ctx:     ctx,
+		file:    os.NewFile(uintptr(fd), "ddsmgr-mrsp"),
+		waiters: map[int32]chan mrspDelivery{},
+		stopped: make(chan struct{}),
+	}
+
+	go d.run()
+
+	return d, nil
+}
+
+func (d *mrspDispatcher) run() {
+	defer close(d.stopped)
+
+	buf := make([]byte, 8)
+	for {
+		if _, err := d.file.Read(buf); err != nil {
+			return
+		}
+		d.drain()
+	}
+}
+
+func (d *mrspDispatcher) drain() {
+	for {
+		mrsp := C.struct_packet_mrsp{}
+		if C.ddsmgr_mrsp_tryrecv(d.ctx, &mrsp) != 0 {
+			return
+		}
+
+		requestid := int32(mrsp.request_id)
+		taken := traceNow()
+
+		d.mtx.Lock()
+		ch := d.waiters[requestid]
+		if ch != nil {
+			delete(d.waiters, requestid)
+			ch <- mrspDelivery{mrsp, taken}
+		}
+		d.mtx.Unlock()
+
+		if ch == nil {
+			C.ddsmgr_mrsp_release(d.ctx, &mrsp)
+		}
+	}
+}
+
+// Registers interest in a request id.  The returned channel receives at
+// most one response.
+func (d *mrspDispatcher) addWaiter(requestid int32) chan mrspDelivery {
+	ch := make(chan mrspDelivery, 1)
+
+	d.mtx.Lock()
+	d.waiters[requestid] = ch
+	d.mtx.Unlock()
+
+	return ch
+}
+
+// Withdraws interest in a request id.  A response that was delivered but
+// never received from the channel is handed back to ddsmgr.
+func (d *mrspDispatcher) removeWaiter(requestid int32,
+	ch chan mrspDelivery) {
+
+	d.mtx.Lock()
+	if d.waiters[requestid] == ch {
+		delete(d.waiters, requestid)
+	}
+	d.mtx.Unlock()
+
+	select {
+	case delivery := <-ch:
+		C.ddsmgr_mrsp_release(d.ctx, &delivery.mrsp)
+	default:
+	}
+}
+
+func (d *mrspDispatcher) stop() {
+	d.file.Close()
+	<-d.stopped
+}
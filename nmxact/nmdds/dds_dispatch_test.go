@@ -0,0 +1,133 @@
+//go:build ddsloopback
+// +build ddsloopback
+
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// These tests run against the loopback stand-in for DDS, whose devices echo
+// every MCmd back as its MRsp; see ddslib/Makefile for how to build it.
+
+package nmdds
+
+import (
+	"bytes"
+	"fmt"
+	"sync"
+	"testing"
+	"time"
+)
+
+func startLoopbackXport(t *testing.T, cfg *XportCfg) *DdsXport {
+	cfg.TargetMatch = "loop0"
+	cfg.CommTimeout = 2 * time.Second
+
+	dx := NewDdsXport(cfg)
+	if err := dx.Start(); err != nil {
+		t.Fatal(err)
+	}
+
+	return dx
+}
+
+func (d *mrspDispatcher) waiterCount() int {
+	d.mtx.Lock()
+	defer d.mtx.Unlock()
+
+	return len(d.waiters)
+}
+
+// Concurrent requests each receive the response to their own request id.
+func TestTxRxDemux(t *testing.T) {
+	dx := startLoopbackXport(t, NewXportCfg())
+	defer dx.Stop()
+
+	var wg sync.WaitGroup
+	for g := 0; g < 16; g++ {
+		wg.Add(1)
+		go func(g int) {
+			defer wg.Done()
+
+			for i := 0; i < 100; i++ {
+				req := []byte(fmt.Sprintf("request %d of goroutine %d", i, g))
+				err := dx.TxRx("loop0", req, func(rsp []byte) error {
+					if !bytes.Equal(rsp, req) {
+						return fmt.Errorf("%q answered with %q", req, rsp)
+					}
+					return nil
+				})
+				if err != nil {
+					t.Error(err)
+					return
+				}
+			}
+		}(g)
+	}
+	wg.Wait()
+
+	if n := dx.mrspd.waiterCount(); n != 0 {
+		t.Fatalf("%d waiters left behind", n)
+	}
+
+	st, err := dx.Stats()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if st.Mrsp.DroppedUnknown != 0 || st.Mrsp.DroppedDuplicate != 0 {
+		t.Fatalf("responses dropped: %+v", st.Mrsp)
+	}
+}
+
+// Requests that give up before their response arrives leave nothing
+// behind, and their late responses never reach a later request.
+func TestTxRxAbandoned(t *testing.T) {
+	dx := startLoopbackXport(t, NewXportCfg())
+	defer dx.Stop()
+
+	for i := 0; i < 64; i++ {
+		req := []byte(fmt.Sprintf("abandoned %d", i))
+		dx.txRx("loop0", req, time.Nanosecond, 0, func(rsp []byte) error {
+			return nil
+		})
+	}
+
+	st, err := dx.Stats()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if st.Mrsp.Timeouts == 0 {
+		t.Fatal("no request gave up")
+	}
+
+	for i := 0; i < 64; i++ {
+		req := []byte(fmt.Sprintf("request %d", i))
+		err := dx.TxRx("loop0", req, func(rsp []byte) error {
+			if !bytes.Equal(rsp, req) {
+				return fmt.Errorf("%q answered with %q", req, rsp)
+			}
+			return nil
+		})
+		if err != nil {
+			t.Fatal(err)
+		}
+	}
+
+	if n := dx.mrspd.waiterCount(); n != 0 {
+		t.Fatalf("%d waiters left behind", n)
+	}
+}
@@ -0,0 +1,172 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package nmdds
+
+// #cgo LDFLAGS: -L ../../ddslib -l ddsmgr
+// #include <stdlib.h>
+// #include "../../ddslib/src/ddsmgr.h"
+import "C"
+
+import (
+	"fmt"
+	"math/rand"
+	"time"
+	"unsafe"
+)
+
+// Outcome of a fanned-out command for one device.  Err is nil if the device
+// responded and rxCb accepted its response.
+type DdsFanoutResult struct {
+	Device string
+	Err    error
+}
+
+// Returns the registry devices whose name matches the shell wildcard
+// pattern, e.g. "sensor-*".
+func (dx *DdsXport) MatchDevices(pattern string) []DdsDevice {
+	if err := dx.acquire(); err != nil {
+		return nil
+	}
+	defer dx.inflight.Done()
+
+	if dx.daemon != nil {
+		return dx.daemon.devices("Match", pattern)
+	}
+
+	cpattern := C.CString(pattern)
+	defer C.free(unsafe.Pointer(cpattern))
+
+	var cdevs []C.struct_ddsmgr_device
+	for {
+		count := int(C.ddsmgr_device_match(dx.ctx, cpattern, nil, 0))
+		if count == 0 {
+			return []DdsDevice{}
+		}
+		cdevs = make([]C.struct_ddsmgr_device, count)
+
+		n := int(C.ddsmgr_device_match(dx.ctx, cpattern, &cdevs[0],
+			C.int(count)))
+		if n <= count {
+			cdevs = cdevs[:n]
+			break
+		}
+	}
+
+	devs := make([]DdsDevice, len(cdevs))
+	for i, _ := range cdevs {
+		devs[i] = newDdsDevice(&cdevs[i])
+	}
+
+	return devs
+}
+
+// Sends the same MCmd to every named device and collects their MRsps
+// within a single CommTimeout, so the whole fleet costs one round trip.
+// rxCb is called once per responding device, in devnames order, with a
+// response that is only valid until rxCb returns.  The returned results
+// are in devnames order as well.
+func (dx *DdsXport) TxFanout(devnames []string, bytes []byte,
+	rxCb func(devname string, rsp []byte) error) (
+	[]DdsFanoutResult, error) {
+
+	return dx.txFanout(devnames, bytes, dx.cfg.CommTimeout,
+		func(i int, rsp []byte) error {
+			return rxCb(devnames[i], rsp)
+		})
+}
+
+// As TxFanout(), but rxCb is given the index into devnames of the device
+// that responded, so that callers need not rely on the order of the calls
+// to match responses to devices; a name may be listed more than once.
+func (dx *DdsXport) txFanout(devnames []string, bytes []byte,
+	commTimeout time.Duration,
+	rxCb func(i int, rsp []byte) error) (
+	[]DdsFanoutResult, error) {
+
+	if err := dx.acquire(); err != nil {
+		return nil, err
+	}
+	defer dx.inflight.Done()
+
+	if len(bytes) == 0 {
+		return nil, fmt.Errorf("Attempt to send empty dds command")
+	}
+	if len(devnames) == 0 {
+		return []DdsFanoutResult{}, nil
+	}
+
+	if dx.daemon != nil {
+		return dx.daemon.txFanout(devnames, bytes, rxCb)
+	}
+
+	timeout := time.Now().Add(commTimeout)
+	if err := dx.waitCommandReady(timeout); err != nil {
+		return nil, err
+	}
+
+	abstimeout := C.struct_abs_timeout{}
+	abstimeout.seconds = C.ulong(timeout.Unix())
+	abstimeout.nseconds = C.long(timeout.Nanosecond())
+
+	// Both arrays only hold C pointers, so they may live in Go memory.
+	cdevnames := make([]*C.char, len(devnames))
+	for i, devname := range devnames {
+		cdevnames[i] = dx.cdevname(devname)
+	}
+	cresults := make([]C.struct_ddsmgr_fanout_result, len(devnames))
+
+	for tries := 1; ; tries++ {
+		rc := C.ddsmgr_mcmd_fanout(dx.ctx, &cdevnames[0],
+			C.int(len(devnames)), C.int(rand.Int31()),
+			(*C.char)(unsafe.Pointer(&bytes[0])), C.int(len(bytes)),
+			&abstimeout, &cresults[0])
+		if rc >= 0 {
+			break
+		}
+		if rc != C.DDSMGR_FANOUT_ID_IN_USE || tries == requestIdTries {
+			return nil, fmt.Errorf(
+				"Failed to register dds fan-out request ids")
+		}
+	}
+	defer C.ddsmgr_mcmd_fanout_release(dx.ctx, &cresults[0],
+		C.int(len(cresults)))
+
+	results := make([]DdsFanoutResult, len(devnames))
+	for i, devname := range devnames {
+		results[i].Device = devname
+
+		r := &cresults[i]
+		switch r.status {
+		case C.DDSMGR_FANOUT_OK:
+			results[i].Err = rxCb(i,
+				cBytesView(r.mrsp.rsp_data, r.mrsp.rsp_size))
+		case C.DDSMGR_FANOUT_TIMEOUT:
+			results[i].Err = fmt.Errorf(
+				"Did not receive a dds command response")
+		case C.DDSMGR_FANOUT_NOBUF:
+			results[i].Err = fmt.Errorf(
+				"No buffer for dds command response")
+		default:
+			results[i].Err = fmt.Errorf("Failed to publish dds command")
+		}
+	}
+
+	return results, nil
+}
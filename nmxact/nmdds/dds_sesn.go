@@ -22,6 +22,8 @@ package nmdds
 import (
 	"fmt"
 	"sync"
+	"sync/atomic"
+	"time"
 
 	"github.com/runtimeco/go-coap"
 
@@ -34,11 +36,13 @@ import (
 )
 
 type DdsSesn struct {
-	cfg    sesn.SesnCfg
-	dx     *DdsXport
-	txvr   *mgmt.Transceiver
-	mopen  sync.Mutex
-	isopen bool
+	cfg     sesn.SesnCfg
+	dx      *DdsXport
+	devname string
+	txvr    *mgmt.Transceiver
+	mopen   sync.Mutex
+	mrx     sync.Mutex
+	isopen  bool
 }
 
 func NewDdsSesn(dx *DdsXport, cfg sesn.SesnCfg) (*DdsSesn, error) {
@@ -71,7 +75,13 @@ func (s *DdsSesn) rx(bytes []byte) error {
 	}
 	s.mopen.Unlock()
 
+	// Concurrent commands deliver their responses from separate goroutines,
+	// but the transceiver's reassembler expects one fragment at a time.
+	// Every MRsp carries a whole NMP response, so serializing here is
+	// enough to keep responses apart.
+	s.mrx.Lock()
 	s.txvr.DispatchNmpRsp(bytes)
+	s.mrx.Unlock()
 
 	return nil
 }
@@ -85,6 +95,16 @@ func (s *DdsSesn) Open() error {
 			"Attempt to open an already-open dds session")
 	}
 
+	// Sessions to a specific device are resolved against the registry
+	// filled by earlier pings rather than by pinging again.
+	devname := s.cfg.PeerSpec.Dds
+	if devname == "" {
+		devname = s.dx.devname
+	} else if _, ok := s.dx.LookupDevice(devname); !ok {
+		s.mopen.Unlock()
+		return fmt.Errorf("Unknown dds device: %s", devname)
+	}
+
 	txvr, err := mgmt.NewTransceiver(s.cfg.TxFilterCb, s.cfg.RxFilterCb,
 					 false, s.cfg.MgmtProto, 3)
 	if err != nil {
@@ -92,6 +112,7 @@ func (s *DdsSesn) Open() error {
 		return err
 	}
 	s.txvr = txvr
+	s.devname = devname
 
 	s.isopen = true
 	s.mopen.Unlock()
@@ -126,7 +147,7 @@ func (s *DdsSesn) IsOpen() bool {
 }
 
 func (s *DdsSesn) MtuIn() int {
-	return 1024 - omp.OMP_MSG_OVERHEAD
+	return s.dx.cfg.RspBufSize - omp.OMP_MSG_OVERHEAD
 }
 
 func (s *DdsSesn) MtuOut() int {
@@ -135,6 +156,10 @@ func (s *DdsSesn) MtuOut() int {
 	return s.dx.cfg.Mtu*3/4 - omp.OMP_MSG_OVERHEAD
 }
 
+func (s *DdsSesn) TxWindow() int {
+	return s.dx.cfg.TxWindow
+}
+
 func (s *DdsSesn) MgmtProto() sesn.MgmtProto {
 	return s.cfg.MgmtProto
 }
@@ -165,15 +190,38 @@ func (s *DdsSesn) TxNmpOnce(m *nmp.NmpMsg, opt sesn.TxOptions) (nmp.NmpRsp, erro
 	}
 	s.mopen.Unlock()
 
+	// Reads are safe to send again if their response is overdue.
+	retransmits := s.dx.cfg.MaxRetransmits
+	if m.Hdr.Op == nmp.NMP_OP_READ && s.dx.cfg.ReadRetransmits > retransmits {
+		retransmits = s.dx.cfg.ReadRetransmits
+	}
+
+	// The dispatcher's reassembler copies the response before decoding it,
+	// so the pool buffer can be handed back as soon as rx returns.
 	txFn := func(bytes []byte) error {
-		return s.dx.Tx(bytes)
+		return s.dx.txRx(s.devname, bytes, s.dx.cfg.CommTimeout, retransmits,
+			s.rx)
 	}
 
-	err := s.dx.setRspSesn(s)
-	if err != nil {
-		return nil, err
+	if s.dx.reads != nil {
+		// Filters may rewrite what is sent or received, so a session with
+		// any only shares reads with itself.
+		scope := ""
+		if s.cfg.TxFilterCb != nil || s.cfg.RxFilterCb != nil {
+			scope = fmt.Sprintf("%p", s)
+		}
+
+		if key := readKey(scope, s.devname, m); key != "" {
+			rsp, shared, err := s.dx.reads.do(key, m.Hdr.Seq, opt.Timeout,
+				func(timeout time.Duration) (nmp.NmpRsp, error) {
+					return s.txvr.TxNmp(txFn, m, s.MtuOut(), timeout)
+				})
+			if shared {
+				atomic.AddUint64(&s.dx.readsShared, 1)
+			}
+			return rsp, err
+		}
 	}
-	defer s.dx.setRspSesn(nil)
 
 	return s.txvr.TxNmp(txFn, m, s.MtuOut(), opt.Timeout)
 }
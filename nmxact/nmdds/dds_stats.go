@@ -0,0 +1,119 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package nmdds
+
+// #cgo LDFLAGS: -L ../../ddslib -l ddsmgr
+// #include <stdlib.h>
+// #include "../../ddslib/src/ddsmgr.h"
+import "C"
+
+import (
+	"sync/atomic"
+	"time"
+)
+
+// Counters for one ddsmgr endpoint.  Dropped counts are broken down by
+// reason: Disabled (nobody was listening), Full (the receive queue was
+// full), Unknown (no registered request took the response), NoBuf (the
+// response payload was lost for want of a buffer) and Duplicate (the
+// request already had its response, as happens when a retransmitted
+// command is answered twice).  PeakWait is the
+// longest time a received sample sat queued before it was consumed.
+type DdsEndpointStats struct {
+	Samples          uint64
+	Converted        uint64
+	Bytes            uint64
+	DroppedDisabled  uint64
+	DroppedFull      uint64
+	DroppedUnknown   uint64
+	DroppedNoBuf     uint64
+	DroppedDuplicate uint64
+	Errors           uint64
+	Timeouts         uint64
+	PeakWait         time.Duration
+}
+
+func (s *DdsEndpointStats) Dropped() uint64 {
+	return s.DroppedDisabled + s.DroppedFull + s.DroppedUnknown +
+		s.DroppedNoBuf + s.DroppedDuplicate
+}
+
+// SharedReads counts read requests that were answered without an MCmd of
+// their own, by an identical request already in flight or by the read
+// cache.  Retransmits counts commands TxRx sent again because their
+// response was overdue.
+type DdsStats struct {
+	Mcmd DdsEndpointStats
+	Mrsp DdsEndpointStats
+	Ping DdsEndpointStats
+	Pong DdsEndpointStats
+
+	SharedReads uint64
+	Retransmits uint64
+}
+
+func newDdsEndpointStats(s *C.struct_ddsmgr_endpoint_stats) DdsEndpointStats {
+	return DdsEndpointStats{
+		Samples:          uint64(s.samples),
+		Converted:        uint64(s.converted),
+		Bytes:            uint64(s.bytes),
+		DroppedDisabled:  uint64(s.dropped_disabled),
+		DroppedFull:      uint64(s.dropped_full),
+		DroppedUnknown:   uint64(s.dropped_unknown),
+		DroppedNoBuf:     uint64(s.dropped_nobuf),
+		DroppedDuplicate: uint64(s.dropped_duplicate),
+		Errors:           uint64(s.errors),
+		Timeouts:         uint64(s.timeouts),
+		PeakWait:         time.Duration(s.peak_wait_ns),
+	}
+}
+
+// Returns a snapshot of the ddsmgr endpoint counters.  TxRx awaits its
+// responses in Go rather than in ddsmgr, so its timeouts are added in;
+// Mrsp.Timeouts counts every command, fanned out or not, whose response
+// did not arrive within CommTimeout.
+func (dx *DdsXport) Stats() (DdsStats, error) {
+	if err := dx.acquire(); err != nil {
+		return DdsStats{}, err
+	}
+	defer dx.inflight.Done()
+
+	// Reads are coalesced by the client's sessions, not by the daemon.
+	if dx.daemon != nil {
+		stats, err := dx.daemon.stats()
+		stats.SharedReads += atomic.LoadUint64(&dx.readsShared)
+		return stats, err
+	}
+
+	var cstats C.struct_ddsmgr_stats
+	C.ddsmgr_stats(dx.ctx, &cstats)
+
+	stats := DdsStats{
+		Mcmd: newDdsEndpointStats(&cstats.mcmd),
+		Mrsp: newDdsEndpointStats(&cstats.mrsp),
+		Ping: newDdsEndpointStats(&cstats.ping),
+		Pong: newDdsEndpointStats(&cstats.pong),
+	}
+	stats.Mrsp.Timeouts += atomic.LoadUint64(&dx.rspTimeouts)
+	stats.SharedReads = atomic.LoadUint64(&dx.readsShared)
+	stats.Retransmits = atomic.LoadUint64(&dx.retransmits)
+
+	return stats, nil
+}
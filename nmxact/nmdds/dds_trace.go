@@ -0,0 +1,92 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package nmdds
+
+// #cgo LDFLAGS: -L ../../ddslib -l ddsmgr
+// #include <stdlib.h>
+// #include "../../ddslib/src/ddsmgr.h"
+import "C"
+
+import (
+	"fmt"
+	"sync/atomic"
+	"unsafe"
+)
+
+// Set while a ddsmgr trace is running, so that the transport's trace points
+// make no cgo calls otherwise.  Like the ddsmgr trace, it is process-wide.
+var tracing int32
+
+// Starts tracing the latency of every request by stage, in the transport
+// and in ddsmgr alike, keeping up to spansPerThread spans per OS thread.
+// Starting a trace discards the previous one.
+func (dx *DdsXport) StartTrace(spansPerThread int) error {
+	if spansPerThread <= 0 ||
+		C.ddsmgr_trace_start(C.uint(spansPerThread)) != 0 {
+
+		return fmt.Errorf("Failed to start dds trace")
+	}
+	atomic.StoreInt32(&tracing, 1)
+
+	return nil
+}
+
+func (dx *DdsXport) StopTrace() {
+	atomic.StoreInt32(&tracing, 0)
+	C.ddsmgr_trace_stop()
+}
+
+// Writes the spans of the last trace as Chrome trace-event JSON, which
+// chrome://tracing and Perfetto open with each request on a track of its
+// own.  Returns the number of spans written.  The trace should be stopped
+// first.
+func (dx *DdsXport) WriteTrace(path string) (int, error) {
+	cpath := C.CString(path)
+	defer C.free(unsafe.Pointer(cpath))
+
+	spans := int(C.ddsmgr_trace_write(cpath))
+	if spans < 0 {
+		return 0, fmt.Errorf("Failed to write dds trace to %s", path)
+	}
+
+	return spans, nil
+}
+
+// Returns the ddsmgr trace clock, or 0 while no trace is running.
+func traceNow() C.ulonglong {
+	if atomic.LoadInt32(&tracing) == 0 {
+		return 0
+	}
+
+	return C.ddsmgr_trace_now()
+}
+
+// Records a span of the given stage from start, as returned by traceNow(),
+// until now.
+func traceSpan(stage C.int, requestid int32, start C.ulonglong) {
+	if start == 0 {
+		return
+	}
+
+	end := C.ddsmgr_trace_now()
+	if end != 0 {
+		C.ddsmgr_trace_span(stage, C.int(requestid), start, end)
+	}
+}
@@ -28,7 +28,9 @@ import (
 	"fmt"
 	"math/rand"
 	"regexp"
+	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 	"unsafe"
 
@@ -39,54 +41,169 @@ type XportCfg struct {
 	CommTimeout time.Duration
 	TargetMatch string
 	Mtu         int
+
+	// How many times TxRx resends a command whose response is overdue
+	// before waiting out the rest of CommTimeout.  Each attempt waits the
+	// device's retransmission timeout, estimated from the round-trip times
+	// of earlier commands, doubled for every attempt before it.  A device
+	// executes every copy of a command it receives, so the default of zero
+	// sends each command once.  Only raise it for commands that are safe
+	// to repeat.
+	MaxRetransmits int
+
+	// The same for NMP read requests sent through a session, which are
+	// safe to repeat, when it is larger than MaxRetransmits.
+	ReadRetransmits int
+
+	// How long Discover() collects pongs after sending its ping.
+	DiscoverWindow time.Duration
+
+	// Number of preallocated slots in each ddsmgr receive queue.  Samples
+	// that arrive while the queue is full are dropped.
+	QueueDepth int
+
+	// Number and size of the preallocated ddsmgr response buffers.  Larger
+	// responses are still received in full, but cost a heap allocation.
+	RspPoolCount int
+	RspBufSize   int
+
+	// Number of slots in the ddsmgr publish queue.  Commands are handed to
+	// a ddsmgr writer thread through it, so a send returns without waiting
+	// for DDS, at the cost of one more copy of every command and a heap
+	// allocation for commands larger than the Mtu.  When the queue is
+	// full, or with the default depth of zero, commands are published on
+	// the calling thread instead.
+	PubQueueDepth int
+
+	// Number of commands a session keeps in flight when the caller
+	// pipelines them.
+	TxWindow int
+
+	// Interfaces to bind a DDS participant to.  Empty picks a single
+	// external interface; "*" binds every up, non-loopback interface.
+	// Commands are sent out on the interface their device was last seen on.
+	Interfaces []string
+
+	// Whether concurrent identical read requests to the same device share
+	// one MCmd and its response, and for how long after it arrives a
+	// successful read response keeps answering identical requests.  A zero
+	// TTL disables the cache.  Off by default: a shared or cached response
+	// may be older than the caller expects, e.g. right after a write.
+	CoalesceReads bool
+	ReadCacheTTL  time.Duration
+
+	// File to write a binary capture of all management traffic to, for
+	// replaying offline with ddsbench.  An existing file is overwritten.
+	// Empty disables capturing.
+	CapturePath string
+
+	// Unix socket of a DdsDaemon to send everything through instead of
+	// bringing up DDS in this process.  When no daemon is listening there,
+	// Start falls back to doing so.  Empty, the default, never uses a
+	// daemon.  Only a daemon running as the same user is used.  Tracing
+	// only covers this process, so traces are taken on the daemon.
+	DaemonSocket string
 }
 
 func NewXportCfg() *XportCfg {
 	return &XportCfg{
-		CommTimeout: 10 * time.Second,
-		TargetMatch: "",
-		Mtu:         512,
+		CommTimeout:     10 * time.Second,
+		TargetMatch:     "",
+		Mtu:             512,
+		MaxRetransmits:  0,
+		ReadRetransmits: 2,
+		DiscoverWindow:  2 * time.Second,
+		QueueDepth:      C.DDSMGR_DEFAULT_QUEUE_DEPTH,
+		RspPoolCount:    C.DDSMGR_DEFAULT_RSP_POOL_COUNT,
+		RspBufSize:      C.DDSMGR_DEFAULT_RSP_BUF_SIZE,
+		PubQueueDepth:   0,
+		TxWindow:        4,
+		CoalesceReads:   false,
+	}
+}
+
+// A device recorded in the ddsmgr registry.  LastSeen is the arrival time of
+// the most recent pong from the device and Interface the interface it
+// arrived on.  Srtt and RttVar are the device's smoothed round-trip time
+// and its variation, zero until a round trip has been measured.
+type DdsDevice struct {
+	Name      string
+	LastSeen  time.Time
+	Interface string
+	Srtt      time.Duration
+	RttVar    time.Duration
+}
+
+func newDdsDevice(d *C.struct_ddsmgr_device) DdsDevice {
+	return DdsDevice{
+		Name: C.GoString(&d.device_name[0]),
+		LastSeen: time.Unix(int64(d.last_seen.seconds),
+			int64(d.last_seen.nseconds)),
+		Interface: C.GoString(&d.interface_name[0]),
+		Srtt:      time.Duration(d.srtt_ns),
+		RttVar:    time.Duration(d.rttvar_ns),
 	}
 }
 
 type DdsXport struct {
-	cfg     *XportCfg
-	devname string
-	mutex   sync.Mutex
-	closing bool
-	rspsesn *DdsSesn
+	// Commands whose response did not arrive in time; see Stats().  Kept
+	// first so that it is 64-bit aligned for atomic access on 32-bit
+	// platforms.
+	rspTimeouts uint64
+
+	// Read requests answered by another caller's MCmd or by the read
+	// cache; see Stats().
+	readsShared uint64
+
+	// Commands sent again because their response was overdue; see
+	// Stats().
+	retransmits uint64
+
+	cfg      *XportCfg
+	devname  string
+	mutex    sync.Mutex
+	closing  bool
+	inflight sync.WaitGroup
+	ctx      *C.struct_ddsmgr_ctx
+	mrspd    *mrspDispatcher
+	reads    *readCoalescer
+
+	// Set instead of ctx when a DdsDaemon does the work.
+	daemon *daemonClient
+
+	// C copies of device names, allocated the first time a device is
+	// addressed and handed to every publish call so that Tx does not
+	// allocate.
+	cdevnames map[string]*C.char
 }
 
 func NewDdsXport(cfg *XportCfg) *DdsXport {
 	x := &DdsXport{}
 
 	x.cfg = cfg
+	x.cdevnames = map[string]*C.char{}
 
 	return x
 }
 
-func (dx *DdsXport) setRspSesn(s *DdsSesn) error {
+func (dx *DdsXport) Start() error {
+	rand.Seed(time.Now().Unix())
+
 	dx.mutex.Lock()
 	defer dx.mutex.Unlock()
 
-	if dx.closing {
-		return fmt.Errorf("Transport dds closed")
+	if dx.cfg.CoalesceReads {
+		dx.reads = newReadCoalescer(dx.cfg.ReadCacheTTL)
 	}
 
-	if s != nil && dx.rspsesn != nil {
-		return fmt.Errorf("Transport dds busy")
+	if dx.cfg.DaemonSocket != "" {
+		daemon, err := dialDaemon(dx.cfg.DaemonSocket, dx.cfg.CommTimeout,
+			dx.cfg.DiscoverWindow)
+		if err == nil {
+			return dx.startDaemon(daemon)
+		}
 	}
 
-	dx.rspsesn = s
-	return nil
-}
-
-func (dx *DdsXport) Start() error {
-	rand.Seed(time.Now().Unix())
-
-	dx.mutex.Lock()
-	defer dx.mutex.Unlock()
-
 	abstimeout := C.struct_abs_timeout{}
 	packetping := C.struct_packet_ping{}
 	packetpong := C.struct_packet_pong{}
@@ -95,23 +212,75 @@ func (dx *DdsXport) Start() error {
 	abstimeout.seconds = C.ulong(timeout.Unix())
 	abstimeout.nseconds = C.long(timeout.Nanosecond())
 
-	rc := C.ddsmgr_initialize(&abstimeout)
-	if rc != 0 {
+	config := C.struct_ddsmgr_config{}
+	config.queue_depth = C.uint(dx.cfg.QueueDepth)
+	config.rsp_pool_count = C.uint(dx.cfg.RspPoolCount)
+	config.rsp_buf_size = C.uint(dx.cfg.RspBufSize)
+	config.pub_queue_depth = C.uint(dx.cfg.PubQueueDepth)
+	config.pub_buf_size = C.DDSMGR_DEFAULT_PUB_BUF_SIZE
+	if dx.cfg.Mtu > C.DDSMGR_DEFAULT_PUB_BUF_SIZE {
+		config.pub_buf_size = C.uint(dx.cfg.Mtu)
+	}
+	if len(dx.cfg.Interfaces) > 0 {
+		config.interfaces = C.CString(strings.Join(dx.cfg.Interfaces, ","))
+		defer C.free(unsafe.Pointer(config.interfaces))
+	}
+	if dx.cfg.CapturePath != "" {
+		config.capture_path = C.CString(dx.cfg.CapturePath)
+		defer C.free(unsafe.Pointer(config.capture_path))
+	}
+
+	dx.ctx = C.ddsmgr_create(&config)
+	if dx.ctx == nil {
 		return fmt.Errorf("Failed to initialize ddsmgr library")
 	}
 
+	mrspd, err := newMrspDispatcher(dx.ctx)
+	if err != nil {
+		dx.destroyCtx()
+		return err
+	}
+	dx.mrspd = mrspd
+
+	// Only the ping/pong endpoints are needed to find the target; the
+	// command endpoints are waited for when the first command is sent.
+	rc := C.ddsmgr_wait_ready(dx.ctx, C.DDSMGR_READY_DISCOVERY, &abstimeout)
+	if rc != 0 {
+		dx.destroyCtx()
+		return fmt.Errorf("Failed to match dds discovery endpoints")
+	}
+
 	targetmatch := regexp.MustCompile(dx.cfg.TargetMatch)
 	devicefound := false
 
 	requestid := rand.Int31()
 	packetping.request_id = C.int(requestid)
 
-	C.ddsmgr_pong_listen()
-	C.ddsmgr_ping_send(&packetping)
+	// The ping is resent with the same id whenever a retransmission
+	// timeout passes without a matching pong, so that a lost ping or pong
+	// costs one timeout rather than the whole CommTimeout.
+	rto := time.Duration(C.DDSMGR_RTO_INITIAL_NS)
+	abspingtimeout := C.struct_abs_timeout{}
+
+	C.ddsmgr_pong_listen(dx.ctx)
+	C.ddsmgr_ping_send(dx.ctx, &packetping)
+	pingtimeout := time.Now().Add(rto)
 	for {
-		rc = C.ddsmgr_pong_recv(&abstimeout, &packetpong)
+		if pingtimeout.After(timeout) {
+			pingtimeout = timeout
+		}
+		abspingtimeout.seconds = C.ulong(pingtimeout.Unix())
+		abspingtimeout.nseconds = C.long(pingtimeout.Nanosecond())
+
+		rc = C.ddsmgr_pong_recv(dx.ctx, &abspingtimeout, &packetpong)
 		if rc != 0 {
-			break
+			if !time.Now().Before(timeout) {
+				break
+			}
+			rto *= 2
+			C.ddsmgr_ping_send(dx.ctx, &packetping)
+			pingtimeout = time.Now().Add(rto)
+			continue
 		}
 
 		in_requestid := int32(packetpong.request_id)
@@ -127,9 +296,10 @@ func (dx *DdsXport) Start() error {
 			break
 		}
 	}
-	C.ddsmgr_pong_reject()
+	C.ddsmgr_pong_reject(dx.ctx)
 
 	if !devicefound {
+		dx.destroyCtx()
 		return fmt.Errorf("Could not find matching dds device")
 	}
 
@@ -138,70 +308,455 @@ func (dx *DdsXport) Start() error {
 	return nil
 }
 
+// Stops the response dispatcher and destroys the ddsmgr context, once
+// nothing uses them any more.
+func (dx *DdsXport) destroyCtx() {
+	if dx.mrspd != nil {
+		dx.mrspd.stop()
+		dx.mrspd = nil
+	}
+
+	if dx.ctx != nil {
+		C.ddsmgr_destroy(dx.ctx)
+		dx.ctx = nil
+	}
+}
+
+// Attaches to a daemon, which resolves TargetMatch against its registry.
+func (dx *DdsXport) startDaemon(daemon *daemonClient) error {
+	devname, err := daemon.attach(dx.cfg.TargetMatch)
+	if err != nil {
+		daemon.close()
+		return err
+	}
+
+	dx.daemon = daemon
+	dx.devname = devname
+
+	fmt.Println("Matched dds device", dx.devname, "through daemon")
+
+	return nil
+}
+
+// Picks the most recently seen registry device whose name matches the
+// regular expression, pinging for window first if none does.
+func (dx *DdsXport) matchTarget(targetMatch string,
+	window time.Duration) (string, error) {
+
+	re, err := regexp.Compile(targetMatch)
+	if err != nil {
+		return "", err
+	}
+
+	match := func(devs []DdsDevice) string {
+		var best *DdsDevice
+		for i, d := range devs {
+			if re.MatchString(d.Name) &&
+				(best == nil || d.LastSeen.After(best.LastSeen)) {
+
+				best = &devs[i]
+			}
+		}
+		if best == nil {
+			return ""
+		}
+		return best.Name
+	}
+
+	if devname := match(dx.Devices()); devname != "" {
+		return devname, nil
+	}
+
+	devs, err := dx.discover(window)
+	if err != nil {
+		return "", err
+	}
+	if devname := match(devs); devname != "" {
+		return devname, nil
+	}
+
+	return "", fmt.Errorf("Could not find matching dds device")
+}
+
 func (dx *DdsXport) Stop() error {
 	dx.mutex.Lock()
-	defer dx.mutex.Unlock()
-
 	dx.closing = true
+	dx.mutex.Unlock()
+
+	// Outstanding calls still reference the context and the device name
+	// handles.
+	dx.inflight.Wait()
+
+	if dx.daemon != nil {
+		dx.daemon.close()
+		dx.daemon = nil
+	}
+
+	dx.destroyCtx()
+
+	for name, cdevname := range dx.cdevnames {
+		C.free(unsafe.Pointer(cdevname))
+		delete(dx.cdevnames, name)
+	}
+
 	return nil
 }
 
-func (dx *DdsXport) BuildSesn(cfg sesn.SesnCfg) (sesn.Sesn, error) {
-	return NewDdsSesn(dx, cfg)
+// Pings every device and collects pongs for XportCfg.DiscoverWindow.
+// Returns the devices that answered; they, and any device that answered an
+// earlier ping, can subsequently be addressed without discovering again.
+func (dx *DdsXport) Discover() ([]DdsDevice, error) {
+	return dx.discover(dx.cfg.DiscoverWindow)
 }
 
-func (dx *DdsXport) Tx(bytes []byte) error {
+func (dx *DdsXport) discover(window time.Duration) ([]DdsDevice, error) {
+	if err := dx.acquire(); err != nil {
+		return nil, err
+	}
+	defer dx.inflight.Done()
+
+	if dx.daemon != nil {
+		return dx.daemon.discover()
+	}
+
 	abstimeout := C.struct_abs_timeout{}
-	packetmcmd := C.struct_packet_mcmd{}
-	packetmrsp := C.struct_packet_mrsp{}
+	packetping := C.struct_packet_ping{}
 
-	timeout := time.Now().Add(dx.cfg.CommTimeout)
+	timeout := time.Now().Add(window)
 	abstimeout.seconds = C.ulong(timeout.Unix())
 	abstimeout.nseconds = C.long(timeout.Nanosecond())
 
 	requestid := rand.Int31()
-	devicename := C.CString(dx.devname)
-	defer C.free(unsafe.Pointer(devicename))
-	cmddata := C.CBytes(bytes)
-	defer C.free(unsafe.Pointer(cmddata))
-	packetmcmd.request_id = C.int(requestid)
-	packetmcmd.device_name = devicename
-	packetmcmd.cmd_data = (*C.char)(unsafe.Pointer(cmddata))
-	packetmcmd.cmd_size = C.int(len(bytes))
-
-	var rc C.int
-	var rsp []byte
-
-	C.ddsmgr_mrsp_listen()
-	C.ddsmgr_mcmd_send(&packetmcmd)
+	packetping.request_id = C.int(requestid)
+
+	C.ddsmgr_discover(dx.ctx, &packetping, &abstimeout)
+
+	devs := []DdsDevice{}
+	for _, d := range dx.listDevices() {
+		if int32(d.request_id) == requestid {
+			devs = append(devs, newDdsDevice(&d))
+		}
+	}
+
+	return devs, nil
+}
+
+// Returns every device in the ddsmgr registry.
+func (dx *DdsXport) Devices() []DdsDevice {
+	if err := dx.acquire(); err != nil {
+		return nil
+	}
+	defer dx.inflight.Done()
+
+	if dx.daemon != nil {
+		return dx.daemon.devices("Devices", "")
+	}
+
+	cdevs := dx.listDevices()
+
+	devs := make([]DdsDevice, len(cdevs))
+	for i, _ := range cdevs {
+		devs[i] = newDdsDevice(&cdevs[i])
+	}
+
+	return devs
+}
+
+// Looks up a single device in the ddsmgr registry without pinging.
+func (dx *DdsXport) LookupDevice(name string) (DdsDevice, bool) {
+	if err := dx.acquire(); err != nil {
+		return DdsDevice{}, false
+	}
+	defer dx.inflight.Done()
+
+	if dx.daemon != nil {
+		return dx.daemon.lookup(name)
+	}
+
+	cdev := C.struct_ddsmgr_device{}
+
+	cname := C.CString(name)
+	defer C.free(unsafe.Pointer(cname))
+
+	if C.ddsmgr_device_lookup(dx.ctx, cname, &cdev) != 0 {
+		return DdsDevice{}, false
+	}
+
+	return newDdsDevice(&cdev), true
+}
+
+func (dx *DdsXport) listDevices() []C.struct_ddsmgr_device {
+	var cdevs []C.struct_ddsmgr_device
+
 	for {
-		rc = C.ddsmgr_mrsp_recv(&abstimeout, &packetmrsp)
-		if rc != 0 {
-			break
+		count := int(C.ddsmgr_device_list(dx.ctx, nil, 0))
+		cdevs = make([]C.struct_ddsmgr_device, count)
+		if count == 0 {
+			return cdevs
 		}
 
-		in_requestid := int32(packetmrsp.request_id)
-		in_rspdata := C.GoBytes(unsafe.Pointer(&packetmrsp.rsp_data[0]),
-		                        packetmrsp.rsp_size)
+		n := int(C.ddsmgr_device_list(dx.ctx, &cdevs[0], C.int(count)))
+		if n <= count {
+			return cdevs[:n]
+		}
+	}
+}
+
+func (dx *DdsXport) BuildSesn(cfg sesn.SesnCfg) (sesn.Sesn, error) {
+	return NewDdsSesn(dx, cfg)
+}
+
+// How many random request ids a command draws before giving up, when each
+// collides with one already in flight.
+const requestIdTries = 16
+
+// Guards a call into the ddsmgr context against a concurrent Stop().  On
+// success the caller must call dx.inflight.Done() once it is finished.
+func (dx *DdsXport) acquire() error {
+	dx.mutex.Lock()
+	defer dx.mutex.Unlock()
+
+	if dx.closing || (dx.ctx == nil && dx.daemon == nil) {
+		return fmt.Errorf("Transport dds closed")
+	}
+	dx.inflight.Add(1)
+
+	return nil
+}
+
+// Waits for the MCmd writer and MRsp reader to match.  Returns immediately
+// once they have.
+func (dx *DdsXport) waitCommandReady(deadline time.Time) error {
+	ready := C.ddsmgr_ready(dx.ctx)
+	if ready&C.DDSMGR_READY_COMMAND == C.DDSMGR_READY_COMMAND {
+		return nil
+	}
+
+	abstimeout := C.struct_abs_timeout{}
+	abstimeout.seconds = C.ulong(deadline.Unix())
+	abstimeout.nseconds = C.long(deadline.Nanosecond())
+
+	if C.ddsmgr_wait_ready(dx.ctx, C.DDSMGR_READY_COMMAND, &abstimeout) != 0 {
+		return fmt.Errorf("Failed to match dds command endpoints")
+	}
+
+	return nil
+}
+
+// Returns the cached C name of a device, creating it on first use.
+func (dx *DdsXport) cdevname(devname string) *C.char {
+	dx.mutex.Lock()
+	defer dx.mutex.Unlock()
+
+	cdevname := dx.cdevnames[devname]
+	if cdevname == nil {
+		cdevname = C.CString(devname)
+		dx.cdevnames[devname] = cdevname
+	}
+
+	return cdevname
+}
+
+// Hands an MCmd to the ddsmgr writer thread, or publishes it on the calling
+// thread if the publish queue is full or disabled.  A queued command that
+// then fails to publish is counted in Stats().Mcmd.Errors; if awaited, its
+// registered request also completes at once with DDSMGR_MRSP_UNPUBLISHED.
+func (dx *DdsXport) mcmdSend(devname string, requestid int32,
+	bytes []byte, awaited bool) error {
+
+	defer traceSpan(C.DDSMGR_TRACE_SEND, requestid, traceNow())
+
+	cdevname := dx.cdevname(devname)
+	cdata := (*C.char)(unsafe.Pointer(&bytes[0]))
+
+	var posted *[0]byte
+	var postedarg unsafe.Pointer
+	if awaited {
+		posted = (*[0]byte)(C.ddsmgr_mcmd_posted)
+		postedarg = unsafe.Pointer(dx.ctx)
+	}
+
+	if C.ddsmgr_mcmd_post(dx.ctx, cdevname, C.int(requestid), cdata,
+		C.int(len(bytes)), posted, postedarg, nil) == 0 {
 
-		if in_requestid == requestid {
-			rsp = in_rspdata
+		return nil
+	}
+
+	if C.ddsmgr_mcmd_publish(dx.ctx, cdevname, C.int(requestid), cdata,
+		C.int(len(bytes))) != 0 {
+
+		return fmt.Errorf("Failed to publish dds command")
+	}
+
+	return nil
+}
+
+// Publishes an MCmd to the matched device without waiting for a response.
+func (dx *DdsXport) Tx(bytes []byte) error {
+	return dx.tx(dx.devname, bytes, dx.cfg.CommTimeout)
+}
+
+func (dx *DdsXport) tx(devname string, bytes []byte,
+	commTimeout time.Duration) error {
+
+	if err := dx.acquire(); err != nil {
+		return err
+	}
+	defer dx.inflight.Done()
+
+	if len(bytes) == 0 {
+		return fmt.Errorf("Attempt to send empty dds command")
+	}
+
+	if dx.daemon != nil {
+		return dx.daemon.tx(devname, bytes)
+	}
+
+	deadline := time.Now().Add(commTimeout)
+	if err := dx.waitCommandReady(deadline); err != nil {
+		return err
+	}
+
+	return dx.mcmdSend(devname, rand.Int31(), bytes, false)
+}
+
+// Transmits an MCmd to the named device and waits for its MRsp.  Several
+// calls may be in flight at once; each waits only for the response carrying
+// its own request id.  The response passed to rxCb aliases a ddsmgr pool
+// buffer and is only valid until rxCb returns.
+//
+// A command whose response is overdue by the device's retransmission
+// timeout is sent again under the same request id, up to
+// XportCfg.MaxRetransmits times; ddsmgr drops any further responses as
+// duplicates.  Only a response to a command sent once is fed back into the
+// device's round-trip estimate.
+func (dx *DdsXport) TxRx(devname string, bytes []byte,
+	rxCb func(rsp []byte) error) error {
+
+	return dx.txRx(devname, bytes, dx.cfg.CommTimeout,
+		dx.cfg.MaxRetransmits, rxCb)
+}
+
+func (dx *DdsXport) txRx(devname string, bytes []byte,
+	commTimeout time.Duration, retransmits int,
+	rxCb func(rsp []byte) error) error {
+
+	tstart := traceNow()
+
+	if err := dx.acquire(); err != nil {
+		return err
+	}
+	defer dx.inflight.Done()
+
+	if len(bytes) == 0 {
+		return fmt.Errorf("Attempt to send empty dds command")
+	}
+
+	if dx.daemon != nil {
+		return dx.daemon.txRx(devname, bytes, retransmits, rxCb)
+	}
+
+	timeout := time.Now().Add(commTimeout)
+	if err := dx.waitCommandReady(timeout); err != nil {
+		return err
+	}
+
+	var requestid int32
+	for tries := 1; ; tries++ {
+		requestid = rand.Int31()
+		rc := C.ddsmgr_mrsp_register(dx.ctx, C.int(requestid))
+		if rc == 0 {
 			break
 		}
+		if rc != C.DDSMGR_ID_IN_USE || tries == requestIdTries {
+			return fmt.Errorf("Failed to register dds request id")
+		}
 	}
-	C.ddsmgr_mrsp_reject()
+	defer C.ddsmgr_mrsp_unregister(dx.ctx, C.int(requestid))
+	defer traceSpan(C.DDSMGR_TRACE_REQUEST, requestid, tstart)
 
-	if rc != 0 {
-		return fmt.Errorf("Did not receive a dds command response")
+	rspch := dx.mrspd.addWaiter(requestid)
+	defer dx.mrspd.removeWaiter(requestid, rspch)
+
+	cdevname := dx.cdevname(devname)
+	rto := time.Duration(C.ddsmgr_device_rto(dx.ctx, cdevname))
+
+	// The command is copied or published straight out of the caller's
+	// slice; cgo pins it for the duration of the call and ddsmgr does not
+	// retain it.
+	sent := time.Now()
+	if err := dx.mcmdSend(devname, requestid, bytes, true); err != nil {
+		return err
 	}
 
-	dx.mutex.Lock()
-	rspsesn := dx.rspsesn
-	dx.mutex.Unlock()
+	timer := time.NewTimer(rtoWait(0, retransmits, rto, timeout))
+	defer timer.Stop()
+
+	var packetmrsp C.struct_packet_mrsp
+	for attempt := 0; ; {
+		select {
+		case delivery := <-rspch:
+			packetmrsp = delivery.mrsp
+			traceSpan(C.DDSMGR_TRACE_HANDOFF, requestid, delivery.taken)
+		case <-timer.C:
+			if !time.Now().Before(timeout) {
+				atomic.AddUint64(&dx.rspTimeouts, 1)
+				return fmt.Errorf("Did not receive a dds command response")
+			}
+			attempt++
+			atomic.AddUint64(&dx.retransmits, 1)
+			if err := dx.mcmdSend(devname, requestid, bytes, true); err != nil {
+				return err
+			}
+			timer.Reset(rtoWait(attempt, retransmits, rto, timeout))
+			continue
+		}
 
-	if rspsesn == nil {
-		return fmt.Errorf("Received dds response with no session")
+		if packetmrsp.rsp_size == C.DDSMGR_MRSP_UNPUBLISHED {
+			return fmt.Errorf("Failed to publish dds command")
+		}
+		if attempt == 0 {
+			C.ddsmgr_device_rtt_sample(dx.ctx, cdevname,
+				C.ulonglong(time.Since(sent)))
+		}
+		break
 	}
+	defer C.ddsmgr_mrsp_release(dx.ctx, &packetmrsp)
 
-	return rspsesn.rx(rsp)
+	if packetmrsp.rsp_data == nil {
+		return fmt.Errorf("No buffer for %d byte dds command response",
+			int(packetmrsp.rsp_size))
+	}
+
+	defer traceSpan(C.DDSMGR_TRACE_RESPOND, requestid, traceNow())
+
+	return rxCb(cBytesView(packetmrsp.rsp_data, packetmrsp.rsp_size))
+}
+
+// Returns how long TxRx waits after the given send attempt, the first being
+// attempt zero: the retransmission timeout doubled once per earlier
+// attempt, or whatever is left until the deadline once the given number of
+// retransmissions are used up.
+func rtoWait(attempt int, retransmits int, rto time.Duration,
+	deadline time.Time) time.Duration {
+
+	remaining := deadline.Sub(time.Now())
+	if attempt >= retransmits {
+		return remaining
+	}
+
+	wait := rto << uint(attempt)
+	if wait <= 0 || wait > remaining {
+		return remaining
+	}
+
+	return wait
+}
+
+// Returns a slice aliasing size bytes of C memory without copying them.
+func cBytesView(data *C.char, size C.int) []byte {
+	if size == 0 {
+		return []byte{}
+	}
+	return (*[1 << 30]byte)(unsafe.Pointer(data))[:size:size]
 }
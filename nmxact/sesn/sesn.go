@@ -112,3 +112,14 @@ type Sesn interface {
 	// Returns a transmit and a receive callback used to manipulate CoAP messages
 	Filters() (nmcoap.MsgFilter, nmcoap.MsgFilter)
 }
+
+// Implemented by sessions that allow several requests to be outstanding at
+// once.  TxNmpOnce may be called concurrently on such a session; each call
+// waits only for the response matching its own sequence number.
+type PipelinedSesn interface {
+	Sesn
+
+	// Retrieves the maximum number of requests that should be in flight at
+	// the same time.
+	TxWindow() int
+}
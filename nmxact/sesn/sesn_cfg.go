@@ -79,6 +79,7 @@ type OnCloseFn func(s Sesn, err error)
 type PeerSpec struct {
 	Ble bledefs.BleDev
 	Udp string
+	Dds string
 }
 
 type SesnCfgBleCentral struct {
@@ -28,6 +28,10 @@ import (
 
 const MAX_PACKET_SIZE = 2048
 
+// Number of requests a UDP session keeps in flight when the caller
+// pipelines them.
+const TX_WINDOW = 4
+
 func Listen(peerString string, dispatchCb func(data []byte)) (
 	*net.UDPConn, *net.UDPAddr, error) {
 
@@ -107,6 +107,12 @@ func (s *UdpSesn) MtuOut() int {
 		nmp.NMP_HDR_SIZE
 }
 
+// Responses are read by a single listener goroutine and routed by sequence
+// number, so several requests may be outstanding at once.
+func (s *UdpSesn) TxWindow() int {
+	return TX_WINDOW
+}
+
 func (s *UdpSesn) TxNmpOnce(m *nmp.NmpMsg, opt sesn.TxOptions) (
 	nmp.NmpRsp, error) {
 
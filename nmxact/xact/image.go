@@ -26,6 +26,7 @@ import (
 
 	"mynewt.apache.org/newtmgr/nmxact/mgmt"
 	"mynewt.apache.org/newtmgr/nmxact/nmp"
+	"mynewt.apache.org/newtmgr/nmxact/nmxutil"
 	"mynewt.apache.org/newtmgr/nmxact/sesn"
 )
 
@@ -40,6 +41,11 @@ type ImageUploadCmd struct {
 	Data       []byte
 	StartOff   int
 	ProgressCb ImageUploadProgressFn
+
+	// Maximum number of chunks in flight at once.  Zero selects the
+	// session's own window if it is a sesn.PipelinedSesn, and one chunk at a
+	// time otherwise.
+	Window int
 }
 
 type ImageUploadResult struct {
@@ -123,7 +129,161 @@ func nextImageUploadReq(s sesn.Sesn, data []byte, off int) (
 	return r, nil
 }
 
+func (c *ImageUploadCmd) window(s sesn.Sesn) int {
+	if c.Window > 0 {
+		if _, ok := s.(sesn.PipelinedSesn); ok {
+			return c.Window
+		}
+		return 1
+	}
+
+	if ps, ok := s.(sesn.PipelinedSesn); ok && ps.TxWindow() > 1 {
+		return ps.TxWindow()
+	}
+
+	return 1
+}
+
+type imageUploadChunk struct {
+	end int
+	rsp *nmp.ImageUploadRsp
+	err error
+}
+
+// Uploads with up to 'window' chunks outstanding.  The device only accepts
+// a chunk that starts at the offset it expects next and answers every
+// other chunk with that offset, so a lost, reordered or rejected chunk
+// shows up as a response whose Off differs from the end of the chunk it
+// answers.  When that happens no further chunks are sent until every
+// outstanding one has been answered; the upload then resumes from the
+// highest offset the device reported.  A chunk that times out is treated
+// the same way, unless a whole round passes without any progress.
+func (c *ImageUploadCmd) runWindowed(s sesn.Sesn, window int) (
+	*ImageUploadResult, error) {
+
+	res := newImageUploadResult()
+	chunks := make(chan imageUploadChunk, window)
+	opt := c.TxOptions()
+
+	next := c.StartOff
+	acked := c.StartOff
+	inflight := 0
+	resync := false
+	progress := false
+	failed := false
+
+	var err error
+	var tmoErr error
+
+	c.curSesn = s
+	defer func() {
+		c.curNmpSeq = 0
+		c.curSesn = nil
+	}()
+
+	for {
+		for !resync && !failed && err == nil && inflight < window &&
+			next < len(c.Data) {
+
+			if c.abortErr != nil {
+				err = c.abortErr
+				break
+			}
+
+			var r *nmp.ImageUploadReq
+			r, err = nextImageUploadReq(s, c.Data, next)
+			if err != nil {
+				break
+			}
+
+			m := r.Msg()
+			end := next + len(r.Data)
+			c.curNmpSeq = m.Hdr.Seq
+			go func() {
+				rsp, err := sesn.TxNmp(s, m, opt)
+				chunk := imageUploadChunk{end: end, err: err}
+				if err == nil {
+					chunk.rsp = rsp.(*nmp.ImageUploadRsp)
+				}
+				chunks <- chunk
+			}()
+
+			next = end
+			inflight++
+		}
+
+		if inflight == 0 {
+			if err != nil {
+				return nil, err
+			}
+			if failed || acked >= len(c.Data) {
+				return res, nil
+			}
+			if !progress {
+				if tmoErr != nil {
+					return nil, tmoErr
+				}
+				return nil, fmt.Errorf("Image upload stalled at offset %d",
+					acked)
+			}
+
+			// Every outstanding chunk has been answered; continue from
+			// where the device says it is.
+			next = acked
+			resync = false
+			progress = false
+			tmoErr = nil
+			continue
+		}
+
+		chunk := <-chunks
+		inflight--
+
+		if chunk.err != nil {
+			if nmxutil.IsRspTimeout(chunk.err) {
+				tmoErr = chunk.err
+				resync = true
+			} else if err == nil {
+				err = chunk.err
+			}
+			continue
+		}
+		if failed || err != nil {
+			continue
+		}
+
+		irsp := chunk.rsp
+		if c.ProgressCb != nil {
+			c.ProgressCb(c, irsp)
+		}
+		res.Rsps = append(res.Rsps, irsp)
+
+		if irsp.Rc != 0 {
+			// Let the outstanding chunks finish, then report the failure.
+			failed = true
+			continue
+		}
+
+		off := int(irsp.Off)
+		if off > acked {
+			acked = off
+			progress = true
+		}
+		if off != chunk.end {
+			resync = true
+		}
+	}
+}
+
 func (c *ImageUploadCmd) Run(s sesn.Sesn) (Result, error) {
+	if window := c.window(s); window > 1 {
+		res, err := c.runWindowed(s, window)
+		if err != nil {
+			return nil, err
+		}
+		return res, nil
+	}
+
 	res := newImageUploadResult()
 
 	for off := c.StartOff; off < len(c.Data); {
@@ -178,6 +338,9 @@ type ImageUpgradeCmd struct {
 	ProgressCb  ImageUploadProgressFn
 	LastOff     uint32
 	ProgressBar *pb.ProgressBar
+
+	// Passed on to the upload command; see ImageUploadCmd.Window.
+	Window int
 }
 
 type ImageUpgradeResult struct {
@@ -251,6 +414,7 @@ func (c *ImageUpgradeCmd) runUpload(s sesn.Sesn) (*ImageUploadResult, error) {
 		cmd.Data = c.Data
 		cmd.StartOff = startOff
 		cmd.ProgressCb = progressCb
+		cmd.Window = c.Window
 		cmd.SetTxOptions(c.TxOptions())
 
 		res, err := cmd.Run(s)
@@ -0,0 +1,262 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+package xact
+
+import (
+	"bytes"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/runtimeco/go-coap"
+
+	"mynewt.apache.org/newtmgr/nmxact/nmcoap"
+	"mynewt.apache.org/newtmgr/nmxact/nmp"
+	"mynewt.apache.org/newtmgr/nmxact/nmxutil"
+	"mynewt.apache.org/newtmgr/nmxact/sesn"
+)
+
+const testUploadWindow = 4
+
+type uploadFault int
+
+const (
+	// The chunk never reaches the device.
+	faultLoseChunk uploadFault = iota + 1
+
+	// The device takes the chunk but its response is lost.
+	faultLoseRsp
+
+	// The device refuses the chunk with an error code.
+	faultReject
+)
+
+// A pipelined session to a device that, like the image manager, only takes
+// a chunk that starts where the previous one ended and answers every chunk
+// with the offset it expects next.  Each fault hits the first transmission
+// of the chunk at its offset; while down, every transmission is lost.
+// Responses are delayed by a varying amount, so they arrive out of order.
+type uploadSesn struct {
+	mtx    sync.Mutex
+	image  []byte
+	off    int
+	sent   int
+	down   bool
+	faults map[uint32]uploadFault
+}
+
+func (s *uploadSesn) Open() error                { return nil }
+func (s *uploadSesn) Close() error               { return nil }
+func (s *uploadSesn) IsOpen() bool               { return true }
+func (s *uploadSesn) MtuIn() int                 { return 1024 }
+func (s *uploadSesn) MtuOut() int                { return 200 }
+func (s *uploadSesn) MgmtProto() sesn.MgmtProto  { return sesn.MGMT_PROTO_NMP }
+func (s *uploadSesn) CoapIsTcp() bool            { return false }
+func (s *uploadSesn) AbortRx(nmpSeq uint8) error { return nil }
+func (s *uploadSesn) TxWindow() int              { return testUploadWindow }
+
+func (s *uploadSesn) RxAccept() (sesn.Sesn, *sesn.SesnCfg, error) {
+	return nil, nil, nil
+}
+
+func (s *uploadSesn) RxCoap(opt sesn.TxOptions) (coap.Message, error) {
+	return nil, nil
+}
+
+func (s *uploadSesn) TxCoapOnce(m coap.Message, resType sesn.ResourceType,
+	opt sesn.TxOptions) (coap.COAPCode, []byte, error) {
+
+	return 0, nil, nil
+}
+
+func (s *uploadSesn) TxCoapObserve(m coap.Message, resType sesn.ResourceType,
+	opt sesn.TxOptions, NotifCb sesn.GetNotifyCb,
+	stopsignal chan int) (coap.COAPCode, []byte, []byte, error) {
+
+	return 0, nil, nil, nil
+}
+
+func (s *uploadSesn) Filters() (nmcoap.MsgFilter, nmcoap.MsgFilter) {
+	return nil, nil
+}
+
+func (s *uploadSesn) TxNmpOnce(m *nmp.NmpMsg, opt sesn.TxOptions) (
+	nmp.NmpRsp, error) {
+
+	req := m.Body.(*nmp.ImageUploadReq)
+
+	s.mtx.Lock()
+	idx := s.sent
+	s.sent++
+	fault := s.faults[req.Off]
+	delete(s.faults, req.Off)
+	if s.down {
+		fault = faultLoseChunk
+	}
+	if fault != faultLoseChunk && fault != faultReject &&
+		int(req.Off) == s.off {
+
+		copy(s.image[s.off:], req.Data)
+		s.off += len(req.Data)
+	}
+	off := s.off
+	s.mtx.Unlock()
+
+	time.Sleep(time.Duration(idx*7%5) * 200 * time.Microsecond)
+
+	switch fault {
+	case faultLoseChunk, faultLoseRsp:
+		return nil, nmxutil.NewRspTimeoutError("NMP timeout")
+	case faultReject:
+		rsp := nmp.NewImageUploadRsp()
+		rsp.Rc = nmp.NMP_ERR_EINVAL
+		return rsp, nil
+	}
+
+	rsp := nmp.NewImageUploadRsp()
+	rsp.Off = uint32(off)
+	return rsp, nil
+}
+
+func testImage() []byte {
+	data := make([]byte, 8000)
+	for i := range data {
+		data[i] = byte(i * 31)
+	}
+	return data
+}
+
+// Returns the offsets at which the chunks of an upload of data start.
+func chunkOffsets(t *testing.T, s sesn.Sesn, data []byte) []uint32 {
+	var offs []uint32
+
+	for off := 0; off < len(data); {
+		r, err := nextImageUploadReq(s, data, off)
+		if err != nil {
+			t.Fatal(err)
+		}
+		offs = append(offs, r.Off)
+		off += len(r.Data)
+	}
+
+	return offs
+}
+
+func runUpload(t *testing.T, s *uploadSesn, data []byte) (
+	*ImageUploadResult, error) {
+
+	cmd := NewImageUploadCmd()
+	opt := cmd.TxOptions()
+	opt.Tries = 2
+	cmd.SetTxOptions(opt)
+	cmd.Data = data
+
+	if w := cmd.window(s); w != testUploadWindow {
+		t.Fatalf("upload window %d, want %d", w, testUploadWindow)
+	}
+
+	res, err := cmd.Run(s)
+	if err != nil {
+		return nil, err
+	}
+	return res.(*ImageUploadResult), nil
+}
+
+func TestImageUploadWindowed(t *testing.T) {
+	data := testImage()
+	s := &uploadSesn{image: make([]byte, len(data))}
+
+	res, err := runUpload(t, s, data)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !bytes.Equal(s.image, data) {
+		t.Fatalf("device holds a corrupt image, offset %d", s.off)
+	}
+	if res.Status() != 0 {
+		t.Fatalf("status %d", res.Status())
+	}
+
+	// Every transmission is answered, and every answer is recorded.
+	if s.sent != len(res.Rsps) {
+		t.Fatalf("%d chunks sent, %d answered", s.sent, len(res.Rsps))
+	}
+}
+
+// A chunk that goes missing makes the device answer the chunks after it
+// with the offset it still expects.  The upload must drain the window and
+// resume from that offset rather than from where it had got to.
+func TestImageUploadResync(t *testing.T) {
+	data := testImage()
+
+	for _, fault := range []uploadFault{faultLoseChunk, faultLoseRsp} {
+		s := &uploadSesn{image: make([]byte, len(data))}
+		offs := chunkOffsets(t, s, data)
+		s.faults = map[uint32]uploadFault{offs[2]: fault, offs[9]: fault}
+
+		res, err := runUpload(t, s, data)
+		if err != nil {
+			t.Fatalf("fault %d: %v", fault, err)
+		}
+		if !bytes.Equal(s.image, data) || s.off != len(data) {
+			t.Fatalf("fault %d: device holds a corrupt image, offset %d",
+				fault, s.off)
+		}
+		if res.Status() != 0 {
+			t.Fatalf("fault %d: status %d", fault, res.Status())
+		}
+		if s.sent <= len(res.Rsps) {
+			t.Fatalf("fault %d: no chunk was sent again", fault)
+		}
+	}
+}
+
+func TestImageUploadStall(t *testing.T) {
+	s := &uploadSesn{image: make([]byte, 8000), down: true}
+
+	// A round without progress gives up instead of retrying forever.
+	_, err := runUpload(t, s, testImage())
+	if !nmxutil.IsRspTimeout(err) {
+		t.Fatalf("expected a timeout, got %v", err)
+	}
+	if s.sent != 2*testUploadWindow {
+		t.Fatalf("%d chunks sent after the device went away", s.sent)
+	}
+}
+
+func TestImageUploadRejected(t *testing.T) {
+	data := testImage()
+	s := &uploadSesn{image: make([]byte, len(data))}
+	offs := chunkOffsets(t, s, data)
+	s.faults = map[uint32]uploadFault{offs[5]: faultReject}
+
+	// The outstanding chunks finish, but the upload goes no further.
+	res, err := runUpload(t, s, data)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if res.Status() != nmp.NMP_ERR_EINVAL {
+		t.Fatalf("status %d", res.Status())
+	}
+	if s.sent >= len(offs) {
+		t.Fatalf("%d of %d chunks sent despite a rejection", s.sent,
+			len(offs))
+	}
+}